@@ -0,0 +1,59 @@
+/*
+ * ======================================================================================================================
+ *  BUS.h - Shared SPI Bus
+ *
+ *  The SD card (CS D4) and the W5500 (CS D10) share SPI0. The SAMD core only reprograms the SERCOM in
+ *  beginTransaction() when the settings differ from the last transaction's, so both devices are run at the one
+ *  clock, cf_spi_mhz. SD and Ethernet transactions can then interleave without the bus being reconfigured, and the
+ *  SD card's 512 byte blocks move at full speed (with DMA on the Adafruit core).
+ *
+ *  Each driver adds up the time its chip select is low. BUS_Stats() reports that against the awake time since
+ *  the last call, millis() does not run in standby.
+ * ======================================================================================================================
+ */
+#define BUS_MHZ_MAX   12    // SAMD21 SERCOM SPI limit at 48MHz, SD cards in SPI mode are good to 25MHz
+
+uint32_t bus_sd_us = 0;     // Driver bus time at the last BUS_Stats()
+uint32_t bus_eth_us = 0;
+unsigned long bus_ms = 0;   // millis() at the last BUS_Stats()
+
+/*
+ * ======================================================================================================================
+ * BUS_Initialize() - Set the SD and W5500 to the shared SPI clock
+ * ======================================================================================================================
+ */
+void BUS_Initialize() {
+  if ((cf_spi_mhz < 1) || (cf_spi_mhz > BUS_MHZ_MAX)) {
+    cf_spi_mhz = BUS_MHZ_MAX;
+  }
+
+  if (SD_exists) {
+    SD.setClock((uint32_t) cf_spi_mhz * 1000000);
+  }
+  w5500.setSPIClock((uint32_t) cf_spi_mhz * 1000000);
+
+  sprintf (msgbuf, "BUS:%dMHz", cf_spi_mhz);
+  Output (msgbuf);
+
+  bus_sd_us = SD.busMicros();
+  bus_eth_us = w5500.busMicros();
+  bus_ms = millis();
+}
+
+/*
+ * ======================================================================================================================
+ * BUS_Stats() - Output SPI bus time per device since the last call
+ * ======================================================================================================================
+ */
+void BUS_Stats() {
+  uint32_t sd = SD.busMicros() - bus_sd_us;
+  uint32_t eth = w5500.busMicros() - bus_eth_us;
+  unsigned long ms = millis() - bus_ms;
+
+  sprintf (msgbuf, "BUS:SD%lums ETH%lums/%lums", (unsigned long)(sd / 1000), (unsigned long)(eth / 1000), ms);
+  Output (msgbuf);
+
+  bus_sd_us += sd;
+  bus_eth_us += eth;
+  bus_ms += ms;
+}
@@ -19,12 +19,62 @@ webserver_port=80
 urlpath=/measurements/url_create
 apikey=1234
 instrument_id=0
+# 1 = POST observations as JSON, the apikey goes in the body and
+#   N2S records go http_batch at a time, urlpath is the server's
+#   JSON endpoint - 0 = Chords GET with a URL (default)
+http_post=0
+# Records per N2S POST, 1-20 (default 10)
+http_batch=10
+# 1 = gzip N2S POST batches, the server must take
+#   Content-Encoding gzip - 0 = no (default)
+http_gzip=0
  
 # Time Server - Make sure firewall allows UDP traffic
 ntpserver=pool.ntp.org
 
 # Distance sensor type - 0 = 5m (default), 1 = 10m
 ds_type=0
+
+# Battery power tiers - enter tier when battery is below volts
+pwr_conserve=3.70
+pwr_batch=3.55
+pwr_logonly=3.40
+
+# SD log durability - 0 = write before every sleep,
+#   1 = every record, N = every N records (default 4).
+#   Records waiting in RAM are lost on a reset or power
+#   loss, up to N-1 of them, 45 minutes at 15m obs
+sd_sync=4
+
+# Wake cycle profile - 0 = off (default), 1 = daily profile log,
+#   2 = daily profile log and add to observations
+profile=0
+
+# SPI clock in MHz for the SD card and W5500, 1-12 (default 12)
+spi_mhz=12
+
+# Daily logs are binary, YYYYMMDD.obs - 1 = also export each
+#   day to JSON lines in YYYYMMDD.log at midnight, 0 = no (default)
+log_json=0
+
+# Order the N2S backlog is sent in - 0 = oldest first (default),
+#   1 = newest first, 2 = newest, then every Nth back, then
+#   the rest newest first
+n2s_drain=0
+# N for n2s_drain=2, 2-1000 (default 12)
+n2s_decimate=12
+
+# UDP collector for observations, HTTP is used when it does
+#   not ACK - blank = off (default)
+udp_collector=
+udp_port=47600
+
+# MQTT broker, observations are published to it QoS 1 instead of
+#   the Chords GET - blank = off (default)
+mqtt_broker=
+mqtt_port=1883
+# Topic is mqtt_topic/instrument_id
+mqtt_topic=ssg
  * ======================================================================================================================
  */
 
@@ -43,9 +93,99 @@ int  cf_webserver_port = 80;
 char *cf_urlpath       = "";
 char *cf_apikey        = "";
 int  cf_instrument_id  = 0;
+int  cf_http_post      = 0;
+int  cf_http_batch     = 10;
+int  cf_http_gzip      = 0;
 
 // Time Server
 char *cf_ntpserver = "";
 
 // Distance Default is 5m
-int cf_ds_type=0; 
+int cf_ds_type=0;
+
+// Battery Power Tiers, volts
+float cf_pwr_conserve = 3.70;
+float cf_pwr_batch    = 3.55;
+float cf_pwr_logonly  = 3.40;
+
+// SD Log Durability Default is every 4 records
+int cf_sd_sync=4;
+
+// Wake Cycle Profile Default is off
+int cf_profile=0; 
+
+// Shared SPI Bus Clock, MHz
+int cf_spi_mhz=12;
+
+// Export Daily Log to JSON Default is off
+int cf_log_json=0;
+
+// N2S Drain Order Default is oldest first
+int cf_n2s_drain=0;
+int cf_n2s_decimate=12;
+
+// UDP Observation Collector Default is off
+char *cf_udp_collector = "";
+int  cf_udp_port       = 47600;
+
+// MQTT Broker Default is off
+char *cf_mqtt_broker = "";
+int  cf_mqtt_port    = 1883;
+char *cf_mqtt_topic  = "ssg";
+
+/*
+ * ======================================================================================================================
+ *  Configuration Schema - Keys read from CONFIG.TXT by SD_ReadConfigFile()
+ *
+ *  A variable keeps its default above when its key is missing or the value is out of range. For strings the range
+ *  is the allowed length and the text is kept in cf_arena.
+ * ======================================================================================================================
+ */
+#define CF_INT        0
+#define CF_FLOAT      1
+#define CF_STR        2
+
+#define CF_ARENA_SIZE 320   // Room for all the string values
+
+typedef struct {
+  const char *key;
+  byte       type;
+  void       *var;
+  float      min;
+  float      max;
+} CF_KEY;
+
+CF_KEY cf_keys[] = {
+  {"ethernet_enable", CF_INT,   &cf_ethernet_enable, 0,   1},
+  {"ethernet_mac",    CF_STR,   &cf_ethernet_mac,    12,  12},
+  {"webserver",       CF_STR,   &cf_webserver,       1,   63},
+  {"webserver_port",  CF_INT,   &cf_webserver_port,  80,  80},       // Only port 80 is supported
+  {"urlpath",         CF_STR,   &cf_urlpath,         1,   63},
+  {"apikey",          CF_STR,   &cf_apikey,          0,   63},
+  {"instrument_id",   CF_INT,   &cf_instrument_id,   0,   999999},
+  {"http_post",       CF_INT,   &cf_http_post,       0,   1},
+  {"http_batch",      CF_INT,   &cf_http_batch,      1,   20},
+  {"http_gzip",       CF_INT,   &cf_http_gzip,       0,   1},
+  {"ntpserver",       CF_STR,   &cf_ntpserver,       1,   63},
+  {"ds_type",         CF_INT,   &cf_ds_type,         0,   1},
+  {"pwr_conserve",    CF_FLOAT, &cf_pwr_conserve,    2.5, 4.5},
+  {"pwr_batch",       CF_FLOAT, &cf_pwr_batch,       2.5, 4.5},
+  {"pwr_logonly",     CF_FLOAT, &cf_pwr_logonly,     2.5, 4.5},
+  {"sd_sync",         CF_INT,   &cf_sd_sync,         0,   1000},
+  {"profile",         CF_INT,   &cf_profile,         0,   2},
+  {"spi_mhz",         CF_INT,   &cf_spi_mhz,         1,   12},
+  {"log_json",        CF_INT,   &cf_log_json,        0,   1},
+  {"n2s_drain",       CF_INT,   &cf_n2s_drain,       0,   2},
+  {"n2s_decimate",    CF_INT,   &cf_n2s_decimate,    2,   1000},
+  {"udp_collector",   CF_STR,   &cf_udp_collector,   0,   63},
+  {"udp_port",        CF_INT,   &cf_udp_port,        1,   65535},
+  {"mqtt_broker",     CF_STR,   &cf_mqtt_broker,     0,   63},
+  {"mqtt_port",       CF_INT,   &cf_mqtt_port,       1,   65535},
+  {"mqtt_topic",      CF_STR,   &cf_mqtt_topic,      1,   63}
+};
+#define CF_KEYS       (int)(sizeof(cf_keys) / sizeof(cf_keys[0]))
+
+char cf_arena[CF_ARENA_SIZE];
+int cf_arena_used = 0;
+int cf_unknown = 0;         // Keys in CONFIG.TXT not in cf_keys
+int cf_invalid = 0;         // Keys with a value that could not be used
@@ -17,28 +17,46 @@
 
 #define DISTANCE_PIN     A3
 #define DISTANCE_BUCKETS 60
+#define DISTANCE_SAMPLE_PERIOD 15        // Seconds between scheduled sub-samples, 60 buckets span a 15m observation
 
-unsigned int distance_buckets = 0;
+unsigned int distance_buckets = 0;       // Number of scheduled sub-samples taken since the last median
+unsigned int distance_samples = DISTANCE_BUCKETS;  // Samples wanted for the median, set by the power policy
 unsigned int distance_bucketss[DISTANCE_BUCKETS];
 
+/* 
+ *=======================================================================================================================
+ * Distance_Sample() - Scheduled sub-sample of the gauge, buckets are used as a ring
+ *=======================================================================================================================
+ */
+void Distance_Sample() {
+  distance_bucketss[distance_buckets % DISTANCE_BUCKETS] = (int) analogRead(DISTANCE_PIN);
+  distance_buckets++;
+}
+
 /* 
  *=======================================================================================================================
  * Distance_Median()
  *=======================================================================================================================
  */
 unsigned int Distance_Median() {
-  int i;
+  unsigned int i;
+  unsigned int n = (distance_buckets < DISTANCE_BUCKETS) ? distance_buckets : DISTANCE_BUCKETS;
 
-  for (i=0; i<DISTANCE_BUCKETS; i++) {
-    // delay(500);
-    delay(250);
-    distance_bucketss[i] = (int) analogRead(DISTANCE_PIN);
-    // sprintf (Buffer32Bytes, "SG[%02d]:%d", i, distance_bucketss[i]);
-    // OutputNS (Buffer32Bytes);
+  // Use the scheduled sub-samples if we have enough, otherwise take a burst of readings now
+  if (n < distance_samples) {
+    n = distance_samples;
+    for (i=0; i<n; i++) {
+      // delay(500);
+      delay(250);
+      distance_bucketss[i] = (int) analogRead(DISTANCE_PIN);
+      // sprintf (Buffer32Bytes, "SG[%02d]:%d", i, distance_bucketss[i]);
+      // OutputNS (Buffer32Bytes);
+    }
   }
+  distance_buckets = 0;
   
-  mysort(distance_bucketss, DISTANCE_BUCKETS);
-  i = (DISTANCE_BUCKETS+1) / 2 - 1; // -1 as array indexing in C starts from 0
+  mysort(distance_bucketss, n);
+  i = (n+1) / 2 - 1; // -1 as array indexing in C starts from 0
 
   if (cf_ds_type) {  // 0 = 5m, 1 = 10m
     return (distance_bucketss[i]*5);
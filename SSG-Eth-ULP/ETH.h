@@ -22,6 +22,8 @@ byte mac[] = { 0xFE, 0xED, 0xC0, 0xDE, 0xBE, 0xEF };
 
 EthernetClient client;
 
+#define ETH_LINK_TIMEOUT 5000  // ms - 100M auto-negotiation normally completes in 2-3s
+
 #define NTP_PACKET_SIZE 48
 #define NTP_TIMEOUT 1500  // ms
 EthernetUDP udp;
@@ -29,6 +31,8 @@ unsigned int localPort = 2390;
 
 bool ip_valid = false;           // True if DHCP
 
+void UDP_Close();                // Prototype this function to aviod compile function unknown issue.
+
 /*
  * ======================================================================================================================
  * Ethernet_SendNTP() - Send a NTP request
@@ -134,15 +138,74 @@ void Ethernet_UpdateTime() {
 
 /*
  * ======================================================================================================================
- * Ethernet_Send_http()
+ * Ethernet_Response() - Wait for the response to the request sent, check its first line and disconnect. Returns 1 for
+ *                       200 OK, -500 for 500 Internal Server Error, 0 otherwise
  * ======================================================================================================================
  */
- int Ethernet_Send_http(char *obs) {
+int Ethernet_Response() {
   char response[64];
   char buf[96];
   int r, exit_timer=0;
   int posted = 0;
 
+  Output("OBS:HTTP SENT");
+
+  // Check for data
+  exit_timer = 0;     
+  while(client.connected() && !client.available()) {     
+    delay(500);
+    if (++exit_timer >= 60) { // after 1 minutes lets call it quits
+      break;
+    }
+  }
+  
+  Output("OBS:HTTP WAIT");
+    
+  // Read first line of HTTP Response, then get out of the loop
+  r=0;
+  response[0] = 0;
+  while ((client.connected() || client.available() ) && r<63 && (posted == 0)) {
+    response[r] = client.read();
+    response[++r] = 0;  // Make string null terminated
+    if (strstr(response, "200 OK") != NULL) { // Does response includes a "200 OK" substring?
+      posted = 1;
+      break;
+    }
+    if (strstr(response, "500 Internal") != NULL) { // Does response includes a This Error substring?
+      posted = -500;
+      break;
+    }        
+    if ((response[r-1] == 0x0A) || (response[r-1] == 0x0D)) { // LF or CR
+      // if we got here then we never saw the 200 OK
+      break;
+    }
+  }
+
+  // Read rest of the response after first line
+  // while (client.connected() || client.available()) { //connected or data available
+  //   char c = client.read(); //gets byte from ethernet buffer
+  //   Serial.print (c);
+  // }
+
+  sprintf (buf, "OBS:%s", response);
+  Output(buf);
+  
+  // Server disconnected from clinet. No data left to read. Disconnect client from the server
+  client.stop();
+
+  sprintf (buf, "OBS:%sPosted=%d", (posted == 1) ? "" : "Not ", posted);
+  Output(buf);
+  return (posted);
+}
+
+/*
+ * ======================================================================================================================
+ * Ethernet_Send_http()
+ * ======================================================================================================================
+ */
+ int Ethernet_Send_http(char *obs) {
+  int posted = 0;
+
   if (Ethernet.link()) {
     Output("OBS:SEND->HTTP");
     if (!client.connect(cf_webserver, cf_webserver_port)) {
@@ -160,57 +223,90 @@ void Ethernet_UpdateTime() {
       client.println("Connection: close");
       client.println();
 
-      Output("OBS:HTTP SENT");
-
-      // Check for data
-      exit_timer = 0;     
-      while(client.connected() && !client.available()) {     
-        delay(500);
-        if (++exit_timer >= 60) { // after 1 minutes lets call it quits
-          break;
-        }
-      }
-      
-      Output("OBS:HTTP WAIT");
-        
-      // Read first line of HTTP Response, then get out of the loop
-      r=0;
-      while ((client.connected() || client.available() ) && r<63 && (posted == 0)) {
-        response[r] = client.read();
-        response[++r] = 0;  // Make string null terminated
-        if (strstr(response, "200 OK") != NULL) { // Does response includes a "200 OK" substring?
-          posted = 1;
-          break;
-        }
-        if (strstr(response, "500 Internal") != NULL) { // Does response includes a This Error substring?
-          posted = -500;
-          break;
-        }        
-        if ((response[r-1] == 0x0A) || (response[r-1] == 0x0D)) { // LF or CR
-          // if we got here then we never saw the 200 OK
-          break;
-        }
-      }
-  
-      // Read rest of the response after first line
-      // while (client.connected() || client.available()) { //connected or data available
-      //   char c = client.read(); //gets byte from ethernet buffer
-      //   Serial.print (c);
-      // }
-
-      sprintf (buf, "OBS:%s", response);
-      Output(buf);
-      
-      // Server disconnected from clinet. No data left to read. Disconnect client from the server
-      client.stop();
-
-      sprintf (buf, "OBS:%sPosted=%d", (posted == 1) ? "" : "Not ", posted);
-      Output(buf);
+      posted = Ethernet_Response();
     }
   }
   return (posted);
 }
 
+/*
+ * ======================================================================================================================
+ * Ethernet_PostHead() - Put the start of a POST body in buf, returns its length. The observations follow as a JSON
+ *                       array, comma separated, then ETH_POST_TAIL.
+ * 
+ * {"instrument_id":7,"key":"1234","obs":[{"at":"2022-02-13T17:26:07","bv":4.11,...},{...}]}
+ * ======================================================================================================================
+ */
+#define ETH_POST_TAIL "]}"
+
+int Ethernet_PostHead(char *buf) {
+  return (sprintf (buf, "{\"instrument_id\":%d,\"key\":\"%s\",\"obs\":[", cf_instrument_id, cf_apikey));
+}
+
+/*
+ * ======================================================================================================================
+ * Ethernet_PostBegin() - Connect and send the headers of a POST to urlpath with a JSON body of len bytes, gzipped
+ *                        when gzip. The caller writes the body to client then calls Ethernet_Response(). Returns
+ *                        false if not connected
+ * ======================================================================================================================
+ */
+bool Ethernet_PostBegin(uint32_t len, bool gzip) {
+  if (!Ethernet.link() || !ip_valid || (cf_webserver_port != 80)) {
+    return (false);
+  }
+
+  Output("OBS:SEND->POST");
+  if (!client.connect(cf_webserver, cf_webserver_port)) {
+    Output("OBS:HTTP FAILED");
+    return (false);
+  }
+  Output("OBS:HTTP CONNECTED");
+
+  client.print("POST ");
+  client.print(cf_urlpath);
+  client.println(" HTTP/1.1");
+  client.print("Host: ");
+  client.println(cf_webserver);
+  client.println("Content-Type: application/json");
+  if (gzip) {
+    client.println("Content-Encoding: gzip");
+  }
+  client.print("Content-Length: ");
+  client.println(len);
+  client.println("Connection: close");
+  client.println();
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * Ethernet_PostBody() - Write the body for the JSON line of one observation to out, or NULL to count it. Returns its
+ *                       length. It is not gzipped, one observation does not get smaller.
+ * ======================================================================================================================
+ */
+uint32_t Ethernet_PostBody(char *obs, Print *out) {
+  char head[128];
+
+  GZ_Begin(out, false);
+  GZ_Write(head, Ethernet_PostHead(head));
+  GZ_Write(obs, strlen(obs));
+  GZ_Write(ETH_POST_TAIL, strlen(ETH_POST_TAIL));
+  return (GZ_End());
+}
+
+/*
+ * ======================================================================================================================
+ * Ethernet_Post() - POST the JSON line of one observation
+ * ======================================================================================================================
+ */
+int Ethernet_Post(char *obs) {
+  if (!Ethernet_PostBegin(Ethernet_PostBody(obs, NULL), false)) {
+    return (0);
+  }
+  Ethernet_PostBody(obs, &client);
+  return (Ethernet_Response());
+}
+
 /*
  * ======================================================================================================================
  * Ethernet_Send_https()
@@ -225,7 +321,7 @@ int Ethernet_Send_https(char *obs) {
 
 /*
  * ======================================================================================================================
- * Ethernet_Send()
+ * Ethernet_Send() - Send obs, a Chords URL, or with http_post the JSON line of the observation
  * ======================================================================================================================
  */
 int Ethernet_Send(char *obs) {
@@ -233,6 +329,9 @@ int Ethernet_Send(char *obs) {
   if (!Ethernet.link() || !ip_valid) {
     return (0); // Not Posted
   }
+  else if (cf_http_post) {
+    return (Ethernet_Post(obs));
+  }
   else {
     if (cf_webserver_port == 80) {
       return (Ethernet_Send_http(obs));
@@ -243,6 +342,26 @@ int Ethernet_Send(char *obs) {
   }
 }
 
+/*
+ * ======================================================================================================================
+ * Ethernet_WaitLink() - After the PHY is powered up, wait for auto-negotiation to bring the link up
+ * ======================================================================================================================
+ */
+bool Ethernet_WaitLink() {
+  unsigned long t0 = millis();
+
+  while (!Ethernet.link()) {
+    if ((millis() - t0) >= ETH_LINK_TIMEOUT) {
+      Output("ETH:LINK TIMEOUT");
+      return (false);
+    }
+    delay (50);
+  }
+  sprintf(msgbuf, "ETH:LINK %lums", millis() - t0);
+  Output(msgbuf);
+  return (true);
+}
+
 /*
  * ======================================================================================================================
  * Ethernet_Validate() -
@@ -324,6 +443,7 @@ bool Ethernet_Renew_DHCP() {
       // We could try and kick the chip!
       // Ethernet.softreset();  // can set only after Ethernet.begin      
       
+      UDP_Close();           // The reset closes every socket
       Ethernet.hardreset();  // You need to set the Rst pin
       Output("ETH:Hard Reset");
       delay (1000);
@@ -354,6 +474,7 @@ bool Ethernet_Renew_DHCP() {
         if ((result == DHCP_CHECK_RENEW_FAIL) || (result == DHCP_CHECK_REBIND_FAIL)) {
           Output("ETH:DHCP Renew Fail");
           
+          UDP_Close();           // The reset closes every socket
           Ethernet.hardreset();  // You need to set the Rst pin
           Output("ETH:Hard Reset");
           delay (1000);
@@ -389,7 +510,22 @@ bool Ethernet_Renew_DHCP() {
 
 /*
  * ======================================================================================================================
- * Ethernet_Initialize() -
+ * Ethernet_Reset() - Hard reset the W5500 early in setup(), it auto-negotiates link while the rest of setup() runs
+ * ======================================================================================================================
+ */
+void Ethernet_Reset() {
+  if (cf_ethernet_enable) {
+    Ethernet.setRstPin(ETHERNET_RESET_PIN);         
+    Ethernet.init(ETHERNET_CS_PIN);    // Initialize Ethernet with the CS pin (default 10)
+
+    Ethernet.hardreset();  // You need to set the Rst pin
+    Output("ETH:Hard Reset");
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Ethernet_Initialize() - Call after Ethernet_Reset()
  * ======================================================================================================================
  */
 void Ethernet_Initialize() {
@@ -404,14 +540,8 @@ void Ethernet_Initialize() {
       hexStringToByteArray(cf_ethernet_mac, mac, 12);
     }
     Output ("ETH:MAC "); for (int i=0; i<6; i++) { sprintf(msgbuf+(i*2), "%02X", mac[i]); } Output (msgbuf);
- 
-    Ethernet.setRstPin(ETHERNET_RESET_PIN);         
-    Ethernet.init(ETHERNET_CS_PIN);    // Initialize Ethernet with the CS pin (default 10)
 
-    Ethernet.hardreset();  // You need to set the Rst pin
-    Output("ETH:Hard Reset");
-    delay (1000);
-  
+    // Ethernet.begin() polls the chip until it is out of reset
     // If cable is unplugged or no link there is a 60s delay as it trys to get an IP
     // Also the ethernet cip could be in low power mode, and needs a reset or power cycled
 
@@ -0,0 +1,278 @@
+/*
+ * ======================================================================================================================
+ *  GZ.h - Gzip Body Encoder
+ *
+ *  Compresses a body as it is written, GZ_Begin(), GZ_Write() for each piece then GZ_End(), into gzip (RFC 1952)
+ *  with one deflate block of the fixed Huffman codes (RFC 1951). Matches are found through a hash of the next 3
+ *  bytes holding only the last place they were seen, and may be up to GZ_WINDOW*2 back. RAM is the buffer, the hash
+ *  table and the output buffer, about 3.2KB. JSON observations all have the same keys, a day of them comes down
+ *  4 times and a batch of 10 about 3. One observation on its own does not get smaller.
+ *
+ *  Output goes to a Print, an EthernetClient or File. With no Print the bytes are only counted, so a body can be
+ *  compressed once for its Content-Length and again to send it. GZ_Begin() can also be told not to compress, then
+ *  bytes are passed through, through the same output buffer.
+ * ======================================================================================================================
+ */
+#define GZ_WINDOW         1024      // Bytes kept when the buffer slides
+#define GZ_BUF            (GZ_WINDOW * 2)
+#define GZ_HASH_BITS      9
+#define GZ_HASH           (1 << GZ_HASH_BITS)
+#define GZ_NONE           0xFFFF
+#define GZ_MIN_MATCH      3
+#define GZ_MAX_MATCH      258
+#define GZ_OUT            128       // Output buffer, a write to Ethernet is a segment
+
+const uint16_t gz_len_base[29]  = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67,
+                                   83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t  gz_len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5,
+                                   5, 0};
+const uint16_t gz_dist_base[22] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                   1025, 1537};   // Distances to GZ_BUF
+
+uint8_t gz_buf[GZ_BUF];             // Input, the window and what is still to compress
+uint16_t gz_head[GZ_HASH];          // Last place in gz_buf of each hash
+uint16_t gz_end = 0;                // Bytes in gz_buf
+uint8_t gz_out[GZ_OUT];
+int gz_outn = 0;
+Print *gz_print = NULL;             // NULL to only count
+bool gz_deflate = false;
+uint32_t gz_bits = 0;               // Bits not yet out, LSB first
+int gz_nbits = 0;
+uint32_t gz_crc = 0;
+uint32_t gz_in = 0;                 // Bytes in
+uint32_t gz_size = 0;               // Bytes out
+
+/*
+ * ======================================================================================================================
+ * GZ_Byte() - Add a byte to the output
+ * ======================================================================================================================
+ */
+void GZ_Byte(uint8_t b) {
+  gz_out[gz_outn++] = b;
+  gz_size++;
+  if (gz_outn == GZ_OUT) {
+    if (gz_print) {
+      gz_print->write(gz_out, gz_outn);
+    }
+    gz_outn = 0;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_Bits() - Add the n low bits of v, LSB first
+ * ======================================================================================================================
+ */
+void GZ_Bits(uint32_t v, int n) {
+  gz_bits |= v << gz_nbits;
+  gz_nbits += n;
+  while (gz_nbits >= 8) {
+    GZ_Byte(gz_bits & 0xFF);
+    gz_bits >>= 8;
+    gz_nbits -= 8;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_Code() - Add a Huffman code of n bits, they go MSB first
+ * ======================================================================================================================
+ */
+void GZ_Code(uint32_t code, int n) {
+  uint32_t r = 0;
+
+  for (int i=0; i<n; i++) {
+    r = (r << 1) | (code & 1);
+    code >>= 1;
+  }
+  GZ_Bits(r, n);
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_Symbol() - Add a literal/length symbol, 0-287, with its fixed code
+ * ======================================================================================================================
+ */
+void GZ_Symbol(int s) {
+  if (s < 144) {
+    GZ_Code(0x30 + s, 8);
+  }
+  else if (s < 256) {
+    GZ_Code(0x190 + s - 144, 9);
+  }
+  else if (s < 280) {
+    GZ_Code(s - 256, 7);
+  }
+  else {
+    GZ_Code(0xC0 + s - 280, 8);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_Match() - Add a match of len bytes dist back
+ * ======================================================================================================================
+ */
+void GZ_Match(int len, int dist) {
+  int c;
+
+  for (c=28; gz_len_base[c] > len; c--);
+  GZ_Symbol(257 + c);
+  GZ_Bits(len - gz_len_base[c], gz_len_extra[c]);
+
+  for (c=21; gz_dist_base[c] > dist; c--);
+  GZ_Code(c, 5);
+  GZ_Bits(dist - gz_dist_base[c], (c < 4) ? 0 : (c / 2) - 1);
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_Hash() - Hash of the 3 bytes at gz_buf[p]
+ * ======================================================================================================================
+ */
+int GZ_Hash(int p) {
+  uint32_t v = ((uint32_t) gz_buf[p] << 16) | (gz_buf[p+1] << 8) | gz_buf[p+2];
+
+  return ((uint32_t)(v * 2654435761UL) >> (32 - GZ_HASH_BITS));
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_Find() - Put gz_buf[p] in the hash and return the length of the match with where its hash was last seen, put
+ *             in c. Matches are not looked for in the last 2 bytes written
+ * ======================================================================================================================
+ */
+int GZ_Find(int p, int *c) {
+  int h, max;
+  int len = 0;
+
+  if ((gz_end - p) >= GZ_MIN_MATCH) {
+    h = GZ_Hash(p);
+    *c = gz_head[h];
+    gz_head[h] = p;
+    if (*c != GZ_NONE) {
+      max = ((gz_end - p) < GZ_MAX_MATCH) ? (gz_end - p) : GZ_MAX_MATCH;
+      while ((len < max) && (gz_buf[*c+len] == gz_buf[p+len])) {
+        len++;
+      }
+    }
+  }
+  return (len);
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_Begin() - Start a body to out, or NULL to count its size. Compressed when deflate, else passed through
+ * ======================================================================================================================
+ */
+void GZ_Begin(Print *out, bool deflate) {
+  const uint8_t header[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 255};  // Deflate, no time, OS unknown
+
+  gz_print = out;
+  gz_deflate = deflate;
+  gz_outn = 0;
+  gz_size = 0;
+  gz_bits = 0;
+  gz_nbits = 0;
+  gz_crc = 0;
+  gz_in = 0;
+  gz_end = 0;
+  for (int h=0; h<GZ_HASH; h++) {
+    gz_head[h] = GZ_NONE;
+  }
+
+  if (gz_deflate) {
+    for (int i=0; i<10; i++) {
+      GZ_Byte(header[i]);
+    }
+    GZ_Bits(1, 1);  // Last block
+    GZ_Bits(1, 2);  // Fixed Huffman codes
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_Write() - Add n bytes of the body. Matches do not reach past the end of what has been written
+ * ======================================================================================================================
+ */
+void GZ_Write(const void *data, int n) {
+  const uint8_t *d = (const uint8_t *) data;
+  int p, piece, h, c, c2, len, len2;
+
+  if (!gz_deflate) {
+    for (int i=0; i<n; i++) {
+      GZ_Byte(d[i]);
+    }
+    return;
+  }
+
+  gz_crc = crc32(gz_crc, d, n);
+  gz_in += n;
+
+  while (n) {
+    if (gz_end == GZ_BUF) {
+      // Keep the last GZ_WINDOW bytes, places in the hash move down with them
+      memmove (gz_buf, gz_buf + GZ_BUF - GZ_WINDOW, GZ_WINDOW);
+      for (h=0; h<GZ_HASH; h++) {
+        gz_head[h] = (gz_head[h] != GZ_NONE && gz_head[h] >= (GZ_BUF - GZ_WINDOW)) ?
+          gz_head[h] - (GZ_BUF - GZ_WINDOW) : GZ_NONE;
+      }
+      gz_end = GZ_WINDOW;
+    }
+
+    piece = (n < (GZ_BUF - gz_end)) ? n : (GZ_BUF - gz_end);
+    memcpy (&gz_buf[gz_end], d, piece);
+    p = gz_end;
+    gz_end += piece;
+    d += piece;
+    n -= piece;
+
+    while (p < gz_end) {
+      len = GZ_Find(p, &c);
+
+      // A longer match from the next byte is worth a literal
+      while ((len >= GZ_MIN_MATCH) && (len < GZ_MAX_MATCH) && ((len2 = GZ_Find(p+1, &c2)) > len)) {
+        GZ_Symbol(gz_buf[p++]);
+        len = len2;
+        c = c2;
+      }
+
+      if (len >= GZ_MIN_MATCH) {
+        GZ_Match(len, p - c);
+        // Put the places we skip in the hash, the next record's keys match them
+        for (int i=1; i<len; i++) {
+          if ((gz_end - (p+i)) >= GZ_MIN_MATCH) {
+            gz_head[GZ_Hash(p+i)] = p+i;
+          }
+        }
+        p += len;
+      }
+      else {
+        GZ_Symbol(gz_buf[p++]);
+      }
+    }
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * GZ_End() - Finish the body and flush it, returns its size in bytes
+ * ======================================================================================================================
+ */
+uint32_t GZ_End() {
+  if (gz_deflate) {
+    GZ_Symbol(256);  // End of block
+    GZ_Bits(0, 7);   // Pad out the last byte
+    gz_bits = 0;
+    gz_nbits = 0;
+    GZ_Bits(gz_crc, 16);
+    GZ_Bits(gz_crc >> 16, 16);
+    GZ_Bits(gz_in, 16);
+    GZ_Bits(gz_in >> 16, 16);
+  }
+  if (gz_print && gz_outn) {
+    gz_print->write(gz_out, gz_outn);
+  }
+  gz_outn = 0;
+  return (gz_size);
+}
@@ -0,0 +1,246 @@
+/*
+ * ======================================================================================================================
+ *  MQTT.h - MQTT 3.1.1 Publisher
+ *
+ *  When mqtt_broker is set observations are published as their JSON line, QoS 1, to mqtt_topic/instrument_id. The
+ *  client id is ssg-instrument_id and the apikey, if there is one, is sent as the password with the client id as
+ *  the user name.
+ *
+ *  The session is not clean, so the broker keeps it between the connections of our wake cycles, and the TCP
+ *  connection is used again while it stays up. Publishes are pipelined, up to MQTT_WINDOW wait for their PUBACK
+ *  at once, so an N2S backlog drains over one connection without a round trip per observation. The N2S drain marks
+ *  a record sent when its PUBACK comes in, one without a PUBACK is published again by a later drain with a new
+ *  packet id. Its sq lets the backend drop the repeat.
+ *
+ *  Tools/mqtt_broker.py is a broker stand-in for a Linux host to try this against.
+ * ======================================================================================================================
+ */
+#define MQTT_CONNECT      0x10
+#define MQTT_CONNACK      0x20
+#define MQTT_PUBLISH_QOS1 0x32
+#define MQTT_PUBACK       0x40
+#define MQTT_DISCONNECT   0xE0
+
+#define MQTT_KEEPALIVE    300       // Seconds, the connection only lasts a drain
+#define MQTT_TIMEOUT      5000      // ms to wait for a CONNACK or PUBACK
+#define MQTT_WINDOW       8         // Publishes waiting for PUBACK at once
+#define MQTT_TOPIC_MAX    80
+
+EthernetClient mqtt_client;
+uint8_t mqtt_pkt[8 + 2 + MQTT_TOPIC_MAX + 2 + MAX_OBS_SIZE];  // Fixed header room, topic, packet id, payload
+uint8_t *mqtt_payload = NULL;       // Where MQTT_Payload() put the payload of the next publish
+uint16_t mqtt_pid = 0;              // Last packet id used
+
+/*
+ * ======================================================================================================================
+ * MQTT_Header() - Put the fixed header for a packet of type with len bytes after it, returns bytes used
+ * ======================================================================================================================
+ */
+int MQTT_Header(uint8_t *p, uint8_t type, uint32_t len) {
+  int n = 0;
+
+  p[n++] = type;
+  do {
+    p[n] = len % 128;
+    len /= 128;
+    if (len) {
+      p[n] |= 0x80;
+    }
+    n++;
+  } while (len);
+  return (n);
+}
+
+/*
+ * ======================================================================================================================
+ * MQTT_String() - Put a length prefixed string, returns bytes used
+ * ======================================================================================================================
+ */
+int MQTT_String(uint8_t *p, const char *s) {
+  int len = strlen(s);
+
+  p[0] = len >> 8;
+  p[1] = len & 0xFF;
+  memcpy (&p[2], s, len);
+  return (len + 2);
+}
+
+/*
+ * ======================================================================================================================
+ * MQTT_Read() - Read the next packet, returns its type or 0 after timeout ms. The first 2 bytes after the fixed
+ *               header, the packet id of a PUBACK, are put in id
+ * ======================================================================================================================
+ */
+uint8_t MQTT_Read(unsigned long timeout, uint16_t *id) {
+  unsigned long t0 = millis();
+  uint32_t len = 0;
+  uint8_t type, b;
+  int shift = 0;
+  int c;
+
+  *id = 0;
+
+  // A byte at a time, each with what is left of the timeout
+  for (int n=0; ; n++) {
+    while (!mqtt_client.available()) {
+      if (!mqtt_client.connected() || ((millis() - t0) >= timeout)) {
+        return (0);
+      }
+    }
+    b = mqtt_client.read();
+    if (n == 0) {
+      type = b;
+    }
+    else {
+      len |= (uint32_t)(b & 0x7F) << shift;
+      shift += 7;
+      if (!(b & 0x80)) {
+        break;
+      }
+    }
+  }
+
+  for (uint32_t n=0; n<len; n++) {
+    while (!mqtt_client.available()) {
+      if (!mqtt_client.connected() || ((millis() - t0) >= timeout)) {
+        return (0);
+      }
+    }
+    c = mqtt_client.read();
+    if (n < 2) {
+      *id = (*id << 8) | c;
+    }
+  }
+  return (type);
+}
+
+/*
+ * ======================================================================================================================
+ * MQTT_Connect() - Connect to the broker unless we are still connected, returns false if we can't
+ * ======================================================================================================================
+ */
+bool MQTT_Connect() {
+  char id[16];
+  uint8_t *p = mqtt_pkt + 8;        // Variable header and payload, the fixed header goes in front
+  uint16_t rc;
+  int len = 0;
+  int h;
+
+  if (mqtt_client.connected()) {
+    return (true);
+  }
+  mqtt_client.stop();
+
+  if (!Ethernet.link() || !ip_valid || !mqtt_client.connect(cf_mqtt_broker, cf_mqtt_port)) {
+    Output ("MQTT:CONNECT ERR");
+    return (false);
+  }
+
+  sprintf (id, "ssg-%d", cf_instrument_id);
+
+  len += MQTT_String(&p[len], "MQTT");
+  p[len++] = 4;                                   // Protocol level 3.1.1
+  p[len++] = (cf_apikey[0]) ? 0xC0 : 0x00;        // User name and password, clean session off
+  p[len++] = MQTT_KEEPALIVE >> 8;
+  p[len++] = MQTT_KEEPALIVE & 0xFF;
+  len += MQTT_String(&p[len], id);
+  if (cf_apikey[0]) {
+    len += MQTT_String(&p[len], id);
+    len += MQTT_String(&p[len], cf_apikey);
+  }
+
+  h = (len < 128) ? 2 : 3;
+  MQTT_Header(p - h, MQTT_CONNECT, len);
+  mqtt_client.write(p - h, h + len);
+
+  // CONNACK is session present then the return code
+  if ((MQTT_Read(MQTT_TIMEOUT, &rc) != MQTT_CONNACK) || (rc & 0xFF)) {
+    sprintf (msgbuf, "MQTT:CONNACK ERR %d", rc & 0xFF);
+    Output (msgbuf);
+    mqtt_client.stop();
+    return (false);
+  }
+
+  sprintf (msgbuf, "MQTT:CONNECTED%s", (rc >> 8) ? " SESSION" : "");
+  Output (msgbuf);
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * MQTT_Payload() - Start a publish, returns where the caller puts its payload string. Connect first, the CONNECT
+ *                  packet is made in the same buffer
+ * ======================================================================================================================
+ */
+char *MQTT_Payload() {
+  char topic[MQTT_TOPIC_MAX];
+  int len;
+
+  snprintf (topic, sizeof(topic), "%s/%d", cf_mqtt_topic, cf_instrument_id);
+  len = MQTT_String(mqtt_pkt + 8, topic);
+  mqtt_payload = mqtt_pkt + 8 + len + 2;  // After the packet id
+  mqtt_payload[0] = 0;
+  return ((char *) mqtt_payload);
+}
+
+/*
+ * ======================================================================================================================
+ * MQTT_Publish() - Publish the payload put at MQTT_Payload() QoS 1, the packet id used is put in id. Returns false
+ *                  if it was not sent
+ * ======================================================================================================================
+ */
+bool MQTT_Publish(uint16_t *id) {
+  uint8_t *p = mqtt_pkt + 8;
+  int len = mqtt_payload - p;
+  int h;
+
+  if (++mqtt_pid == 0) {
+    mqtt_pid = 1;                   // Packet id 0 is not allowed
+  }
+  *id = mqtt_pid;
+
+  mqtt_payload[-2] = mqtt_pid >> 8;
+  mqtt_payload[-1] = mqtt_pid & 0xFF;
+  len += strlen((char *) mqtt_payload);
+
+  // The fixed header is 2 or 3 bytes, put it right in front of the rest so it all goes in one write
+  h = (len < 128) ? 2 : 3;
+  MQTT_Header(p - h, MQTT_PUBLISH_QOS1, len);
+  return (mqtt_client.write(p - h, h + len) == (size_t)(h + len));
+}
+
+/*
+ * ======================================================================================================================
+ * MQTT_Send() - Publish the payload put at MQTT_Payload() and wait for its PUBACK, returns 1 when it is
+ *               acknowledged
+ * ======================================================================================================================
+ */
+int MQTT_Send() {
+  uint16_t id, acked;
+  unsigned long t0 = millis();
+
+  if (!MQTT_Publish(&id)) {
+    return (0);
+  }
+  while ((millis() - t0) < MQTT_TIMEOUT) {
+    if ((MQTT_Read(MQTT_TIMEOUT - (millis() - t0), &acked) == MQTT_PUBACK) && (acked == id)) {
+      return (1);
+    }
+  }
+  Output ("MQTT:NO PUBACK");
+  return (0);
+}
+
+/*
+ * ======================================================================================================================
+ * MQTT_Disconnect() - Say goodbye to the broker, the session stays with it
+ * ======================================================================================================================
+ */
+void MQTT_Disconnect() {
+  uint8_t pkt[2] = {MQTT_DISCONNECT, 0};
+
+  if (mqtt_client.connected()) {
+    mqtt_client.write(pkt, 2);
+  }
+  mqtt_client.stop();
+}
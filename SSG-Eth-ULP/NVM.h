@@ -0,0 +1,256 @@
+/*
+ * ======================================================================================================================
+ *  NVM.h - Configuration Snapshot in Internal Flash
+ *
+ *  The parsed configuration (the cf_keys values and cf_arena) is kept in a reserved, row aligned area of the
+ *  SAMD21's program flash, the same way the FlashStorage library emulates EEPROM. The snapshot is versioned and CRC
+ *  checked, and remembers the size and CRC of the CONFIG.TXT it came from so it is only rewritten when the file or
+ *  the cf_keys table changes. When CONFIG.TXT can not be read at boot the snapshot is used instead.
+ *
+ *  Uploading new firmware clears the area, the snapshot is rewritten from CONFIG.TXT on the next boot with an SD.
+ *
+ *  A second row holds the observation sequence number. Numbers are reserved NVM_SEQ_BLOCK at a time, the end of each
+ *  block is programmed into the next erased word of the row and the row is only erased when all its words are used.
+ *  A reset skips the rest of the block it was in. The end of each block is also written to SD_seq_file before a
+ *  number from it is used. A firmware upload erases the row but not the card, so with an SD card the sequence
+ *  carries on above every number it has used. Without one it restarts from the seconds since NVM_SEQ_EPOCH. That
+ *  stays ahead unless the station has averaged a reset every NVM_SEQ_BLOCK seconds since it first numbered.
+ * ======================================================================================================================
+ */
+#define NVM_MAGIC       0x53464E43        // "CNFS"
+#define NVM_VERSION     1
+#define NVM_PAGE_SIZE   64                // SAMD21 flash page, the unit of writing
+#define NVM_ROW_SIZE    256               // 4 pages, the unit of erasing
+#define NVM_DATA_SIZE   (CF_KEYS*4 + CF_ARENA_SIZE)
+#define NVM_SEQ_BLOCK   64                // Sequence numbers reserved by each write
+#define NVM_SEQ_WORDS   (NVM_ROW_SIZE/4)
+#define NVM_SEQ_EPOCH   1577836800UL      // 2020-01-01T00:00:00
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length;                        // Bytes of data used
+  uint32_t schema;                        // CRC of the cf_keys table
+  uint32_t file_size;                     // CONFIG.TXT the snapshot was made from
+  uint32_t file_crc;
+  uint32_t crc;                           // CRC of the snapshot with this set to 0
+  uint8_t  data[NVM_DATA_SIZE];           // A 4 byte value or arena offset per key, then the arena
+} NVM_SNAPSHOT;
+
+#define NVM_HEADER_SIZE (sizeof(NVM_SNAPSHOT) - NVM_DATA_SIZE)
+
+NVM_SNAPSHOT nvm_snapshot;                // Working copy, too big for the stack
+
+__attribute__((__aligned__(NVM_ROW_SIZE)))
+const volatile uint8_t nvm_flash[(sizeof(NVM_SNAPSHOT) + NVM_ROW_SIZE - 1) / NVM_ROW_SIZE * NVM_ROW_SIZE] = { };
+
+__attribute__((__aligned__(NVM_ROW_SIZE)))
+const volatile uint32_t nvm_seq_flash[NVM_SEQ_WORDS] = { };
+
+uint32_t SD_SeqLoad();                    // Prototype these functions to aviod compile function unknown issue.
+bool SD_SeqSave(uint32_t limit);
+
+uint32_t nvm_seq = 0;                     // Next observation sequence number
+uint32_t nvm_seq_limit = 0;               // End of the block reserved in flash, 0 until the first number is taken
+
+/*
+ * ======================================================================================================================
+ * NVM_Schema() - CRC of the cf_keys names, types and ranges, a snapshot from another table is not used
+ * ======================================================================================================================
+ */
+uint32_t NVM_Schema() {
+  uint32_t crc = 0;
+
+  for (int i=0; i<CF_KEYS; i++) {
+    crc = crc32(crc, cf_keys[i].key, strlen(cf_keys[i].key) + 1);
+    crc = crc32(crc, &cf_keys[i].type, sizeof(cf_keys[i].type));
+    crc = crc32(crc, &cf_keys[i].min, sizeof(cf_keys[i].min));
+    crc = crc32(crc, &cf_keys[i].max, sizeof(cf_keys[i].max));
+  }
+  return (crc);
+}
+
+/*
+ * ======================================================================================================================
+ * NVM_Read() - Copy the snapshot out of flash, returns true if it is valid for this firmware
+ * ======================================================================================================================
+ */
+bool NVM_Read(NVM_SNAPSHOT *s) {
+  uint32_t crc;
+
+  for (size_t i=0; i<sizeof(NVM_SNAPSHOT); i++) {
+    ((uint8_t *) s)[i] = nvm_flash[i];
+  }
+
+  if ((s->magic != NVM_MAGIC) || (s->version != NVM_VERSION) || (s->length > NVM_DATA_SIZE) ||
+      (s->length < CF_KEYS*4) || (s->schema != NVM_Schema())) {
+    return (false);
+  }
+  crc = s->crc;
+  s->crc = 0;
+  if (crc32(0, s, NVM_HEADER_SIZE + s->length) != crc) {
+    return (false);
+  }
+  s->crc = crc;
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * NVM_Erase() - Erase rows of flash, all bits of an erased word are 1
+ * ======================================================================================================================
+ */
+void NVM_Erase(const volatile void *flash, size_t size) {
+  for (size_t row=0; row<size; row+=NVM_ROW_SIZE) {
+    NVMCTRL->ADDR.reg = ((uint32_t) flash + row) / 2;  // 16 bit word address
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_ER;
+    while (!NVMCTRL->INTFLAG.bit.READY) {}
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * NVM_Program() - Program words into erased flash a page at a time, words of a page not given are left as they are
+ * ======================================================================================================================
+ */
+void NVM_Program(const volatile uint32_t *flash, const uint32_t *src, int words) {
+  volatile uint32_t *dst = (volatile uint32_t *) flash;
+
+  // Pages are written by command, not when the page buffer fills
+  NVMCTRL->CTRLB.bit.MANW = 1;
+
+  while (words) {
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_PBC;
+    while (!NVMCTRL->INTFLAG.bit.READY) {}
+
+    // Flash only takes 32 bit writes to the page buffer
+    do {
+      *dst++ = *src++;
+      words--;
+    } while (words && ((uint32_t) dst % NVM_PAGE_SIZE));
+
+    NVMCTRL->CTRLA.reg = NVMCTRL_CTRLA_CMDEX_KEY | NVMCTRL_CTRLA_CMD_WP;
+    while (!NVMCTRL->INTFLAG.bit.READY) {}
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * NVM_Write() - Erase the flash area and program the snapshot into it
+ * ======================================================================================================================
+ */
+void NVM_Write(const NVM_SNAPSHOT *s) {
+  NVM_Erase(nvm_flash, sizeof(nvm_flash));
+  NVM_Program((const volatile uint32_t *) nvm_flash, (const uint32_t *) s, (sizeof(NVM_SNAPSHOT) + 3) / 4);
+}
+
+/*
+ * ======================================================================================================================
+ * NVM_Save() - Snapshot the configuration read from a CONFIG.TXT of file_size bytes and file_crc, if it has changed
+ * ======================================================================================================================
+ */
+void NVM_Save(uint32_t file_size, uint32_t file_crc) {
+  NVM_SNAPSHOT &s = nvm_snapshot;
+  uint32_t v;
+
+  if (NVM_Read(&s) && (s.file_size == file_size) && (s.file_crc == file_crc)) {
+    return;
+  }
+
+  memset(&s, 0, sizeof(s));
+  s.magic = NVM_MAGIC;
+  s.version = NVM_VERSION;
+  s.schema = NVM_Schema();
+  s.file_size = file_size;
+  s.file_crc = file_crc;
+
+  for (int i=0; i<CF_KEYS; i++) {
+    if (cf_keys[i].type == CF_STR) {
+      char *str = *(char **)cf_keys[i].var;
+
+      // Strings still at their default are not in the arena
+      v = ((str >= cf_arena) && (str < (cf_arena + CF_ARENA_SIZE))) ? (str - cf_arena) : 0xFFFFFFFF;
+    }
+    else {
+      memcpy(&v, cf_keys[i].var, 4);  // int and float
+    }
+    memcpy(&s.data[i*4], &v, 4);
+  }
+  memcpy(&s.data[CF_KEYS*4], cf_arena, cf_arena_used);
+  s.length = CF_KEYS*4 + cf_arena_used;
+  s.crc = crc32(0, &s, NVM_HEADER_SIZE + s.length);
+
+  NVM_Write(&s);
+
+  Output (NVM_Read(&s) ? "NVM:CF SAVED" : "NVM:CF SAVE ERR");
+}
+
+/*
+ * ======================================================================================================================
+ * NVM_Load() - Set the configuration from the flash snapshot, returns false if there is no valid snapshot
+ * ======================================================================================================================
+ */
+bool NVM_Load() {
+  NVM_SNAPSHOT &s = nvm_snapshot;
+  uint32_t v;
+
+  if (!NVM_Read(&s)) {
+    return (false);
+  }
+
+  cf_arena_used = s.length - CF_KEYS*4;
+  memcpy(cf_arena, &s.data[CF_KEYS*4], cf_arena_used);
+
+  for (int i=0; i<CF_KEYS; i++) {
+    memcpy(&v, &s.data[i*4], 4);
+    if (cf_keys[i].type == CF_STR) {
+      if (v < (uint32_t) cf_arena_used) {
+        *(char **)cf_keys[i].var = cf_arena + v;
+      }
+    }
+    else {
+      memcpy(cf_keys[i].var, &v, 4);
+    }
+  }
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * NVM_SeqNext() - Take the next observation sequence number. floor is where to start when flash and SD have none
+ * ======================================================================================================================
+ */
+uint32_t NVM_SeqNext(uint32_t floor) {
+  int w;
+
+  // First number since reset, carry on from the end of the last block reserved
+  if (nvm_seq_limit == 0) {
+    nvm_seq = SD_SeqLoad();
+    if (floor > nvm_seq) {
+      nvm_seq = floor;
+    }
+    for (w=0; w<NVM_SEQ_WORDS; w++) {
+      if ((nvm_seq_flash[w] != 0xFFFFFFFF) && (nvm_seq_flash[w] > nvm_seq)) {
+        nvm_seq = nvm_seq_flash[w];
+      }
+    }
+  }
+
+  if (nvm_seq >= nvm_seq_limit) {
+    nvm_seq_limit = nvm_seq + NVM_SEQ_BLOCK;
+
+    for (w=0; (w<NVM_SEQ_WORDS) && (nvm_seq_flash[w] != 0xFFFFFFFF); w++) {}
+    if (w == NVM_SEQ_WORDS) {
+      NVM_Erase(nvm_seq_flash, sizeof(nvm_seq_flash));
+      w = 0;
+    }
+    NVM_Program(&nvm_seq_flash[w], &nvm_seq_limit, 1);
+    if (!SD_SeqSave(nvm_seq_limit)) {
+      Output ("NVM:SQ SD ERR");
+    }
+
+    sprintf (msgbuf, "NVM:SQ %lu-%lu", (unsigned long) nvm_seq, (unsigned long) nvm_seq_limit - 1);
+    Output (msgbuf);
+  }
+  return (nvm_seq++);
+}
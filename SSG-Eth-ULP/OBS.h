@@ -34,19 +34,168 @@ OBSERVATION_STR obs;
 unsigned long Time_of_obs = 0;              // unix time of observation
 unsigned long Time_of_next_obs = 0;         // time of next observation
 
+/*
+ * ======================================================================================================================
+ *  Observation Records - How an observation is kept in the daily log and N2S file
+ *
+ *  [length][OBS_SCHEMA][fields][ts][hth][bv][values]. fields has a bit per obs_fields entry present, the values
+ *  follow in table order as 2 or 4 byte signed integers of the value times scale, little endian. A field is added
+ *  at the end of the table. Anything else that changes a record needs a new OBS_SCHEMA.
+ *
+ *  In the daily log most observations are a delta record from the one before, [length][OBS_SCHEMA_DELTA] then
+ *  varints of: ts minus the previous ts and the previous interval (zig-zag), hth xor the previous hth, and bv and
+ *  each value minus its previous value (zig-zag). A full record is a keyframe. The log starts with one, and has one
+ *  at least every OBS_KEYFRAME observations and whenever the fields present change. The interval starts at 0 after
+ *  a keyframe. Text records between observations do not take part. A record lost to a torn or corrupt frame
+ *  breaks the chain, readers drop deltas until the next keyframe. The log is reopened with a keyframe after a reset.
+ *
+ *  Every observation carries sq, a sequence number that only goes up, see NVM_SeqNext(). An observation sent twice,
+ *  from a send that timed out after the server stored it and from N2S, has the same sq. The server can drop a
+ *  repeat of an instrument_id and sq it already has.
+ *
+ *  Tools/obs2json.py on the host converts a log to the same JSON lines as OBS_Export(). Keep its field table and
+ *  decoding in step with this.
+ * ======================================================================================================================
+ */
+#define OBS_SCHEMA          1
+#define OBS_SCHEMA_DELTA    2
+#define OBS_KEYFRAME        24      // At most this many delta records between keyframes
+#define OBS_REC_FIELDS      2       // uint32
+#define OBS_REC_TS          6       // uint32 unix time
+#define OBS_REC_HTH         10      // uint32 system status bits
+#define OBS_REC_BV          14      // int16 battery volts * 100
+#define OBS_REC_DATA        16
+
+typedef struct {
+  const char    *id;
+  int           type;               // F_OBS or I_OBS, how the value is rendered
+  uint8_t       size;               // Bytes stored
+  uint8_t       scale;              // Stored value is the observation times this
+} OBS_FIELD;
+
+OBS_FIELD obs_fields[] = {
+  {"sg",   F_OBS, 2, 1},            // mm
+  {"dt1",  F_OBS, 2, 10},
+  {"bp1",  F_OBS, 2, 10},
+  {"bt1",  F_OBS, 2, 10},
+  {"bh1",  F_OBS, 2, 10},
+  {"bp2",  F_OBS, 2, 10},
+  {"bt2",  F_OBS, 2, 10},
+  {"bh2",  F_OBS, 2, 10},
+  {"mt1",  F_OBS, 2, 10},
+  {"mt2",  F_OBS, 2, 10},
+  {"st1",  F_OBS, 2, 10},
+  {"sh1",  F_OBS, 2, 10},
+  {"st2",  F_OBS, 2, 10},
+  {"sh2",  F_OBS, 2, 10},
+  {"pwk",  I_OBS, 4, 1},            // Wake cycle profile, ms
+  {"ptk",  I_OBS, 4, 1},
+  {"plg",  I_OBS, 4, 1},
+  {"psn",  I_OBS, 4, 1},
+  {"pns",  I_OBS, 4, 1},
+  {"pdh",  I_OBS, 4, 1},
+  {"pqt",  I_OBS, 4, 1},
+  {"psl",  I_OBS, 4, 1},
+  {"pmas", F_OBS, 4, 10},           // mA*s
+  {"sq",   I_OBS, 4, 1},            // Observation sequence number
+  {"n2sn", I_OBS, 2, 1},            // Last N2S drain, records sent
+  {"n2sb", I_OBS, 2, 1},            //   records left
+  {"n2sr", I_OBS, 2, 1}             //   smoothed send time, ms
+};
+#define OBS_FIELDS  (int)(sizeof(obs_fields) / sizeof(obs_fields[0]))
+#define OBS_FIELD_SQ  23            // obs_fields index of sq
+
+// N2S drain order, cf_n2s_drain
+#define OBS_N2S_FIFO        0       // Oldest first
+#define OBS_N2S_LIFO        1       // Newest first
+#define OBS_N2S_DECIMATE    2       // Newest, then every cf_n2s_decimate back, then the rest newest first
+
+uint8_t obs_rec[SD_REC_MAX];        // Record of the current observation, made by OBS_Take()
+
+uint8_t obs_log_prev[SD_REC_MAX];   // Full record of the last observation in the log, the base of the next delta
+uint32_t obs_log_interval = 0;      // Seconds between the last two observations in the log
+int obs_log_deltas = 0;             // Delta records since the last keyframe
+
+// N2S drain pacing and metrics, see OBS_N2S_Publish()
+#define OBS_N2S_GAP_MIN     100     // ms between sends, half the smoothed send time kept within these
+#define OBS_N2S_GAP_MAX     2000
+uint32_t obs_n2s_rtt = 0;           // Smoothed time to send a record and get the reply, ms
+int obs_n2s_sent = -1;              // Records the last drain sent, -1 once added to an observation
+uint32_t obs_n2s_left = 0;          // Records left to send after the last drain
+
+// N2S records published to the MQTT broker and waiting for their PUBACK, see OBS_N2S_PubAck()
+typedef struct {
+  uint16_t id;                      // MQTT packet id
+  int32_t i;                        // N2S index entry and its value
+  uint32_t entry;
+  unsigned long t0;                 // millis() when published
+} OBS_N2S_FLIGHT;
+OBS_N2S_FLIGHT obs_n2s_flight[MQTT_WINDOW];
+int obs_n2s_flying = 0;
+
+// N2S records to go in one POST with http_post, see OBS_N2S_Post()
+#define OBS_N2S_BATCH_MAX   20
+typedef struct {
+  int32_t i;                        // N2S index entry and its value
+  uint32_t entry;
+  uint16_t len;                     // Of its JSON line
+} OBS_N2S_BATCH;
+OBS_N2S_BATCH obs_n2s_batch[OBS_N2S_BATCH_MAX];
+
 
-void OBS_N2S_Publish();   // Prototype this function to aviod compile function unknown issue.
+void OBS_N2S_Publish();                     // Prototype this function to aviod compile function unknown issue.
+uint32_t SCH_N2S_Budget(uint32_t left);
+bool OBS_Field(const uint8_t *rec, int f, int32_t *v);
+bool OBS_Render(const uint8_t *rec, char *buf, bool url);
 
 /*
  * ======================================================================================================================
- * OBS_Send() - Do a GET request to log observation, process returned text for result code and set return status
+ * OBS_N2S_Gap() - ms to wait between N2S sends, half the smoothed send time within OBS_N2S_GAP_MIN and MAX
  * ======================================================================================================================
  */
-int OBS_Send(char *obs)
+uint32_t OBS_N2S_Gap() {
+  uint32_t gap = obs_n2s_rtt / 2;
+
+  return ((gap < OBS_N2S_GAP_MIN) ? OBS_N2S_GAP_MIN : ((gap > OBS_N2S_GAP_MAX) ? OBS_N2S_GAP_MAX : gap));
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_Send() - Publish the record rec to the MQTT broker, or send it as a datagram, when there is one. If there is
+ *              none or it does not acknowledge, do a GET request of its URL obs to log observation, process returned
+ *              text for result code and set return status
+ * ======================================================================================================================
+ */
+int OBS_Send(const uint8_t *rec, char *obs)
 {
+  unsigned long t0;
+  int32_t sq;
+  int result;
+
   // Handle Eth can return 0=not sent, -500=ErrorCode Not Sent, 1=Sent
   if (cf_ethernet_enable) {
-    return (Ethernet_Send(obs));
+    if (cf_mqtt_broker[0]) {
+      t0 = millis();
+      result = (MQTT_Connect() && OBS_Render(rec, MQTT_Payload(), false)) ? MQTT_Send() : 0;
+      UDP_Cost(UDP_VIA_MQTT, millis() - t0, (result == 1));
+      if (result == 1) {
+        return (result);
+      }
+    }
+
+    if (cf_udp_collector[0] && OBS_Field(rec, OBS_FIELD_SQ, &sq)) {
+      t0 = millis();
+      result = UDP_Send(rec, sq);
+      UDP_Cost(UDP_VIA_UDP, millis() - t0, (result == 1));
+      if (result == 1) {
+        return (result);
+      }
+    }
+
+    t0 = millis();
+    result = Ethernet_Send(obs);
+    UDP_Cost(UDP_VIA_HTTP, millis() - t0, (result == 1));
+    return (result);
   }
   else {
     Output("No Valid Network");
@@ -68,55 +217,414 @@ void OBS_Clear() {
 
 /*
  * ======================================================================================================================
- * OBS_N2S_Add() - Save OBS to N2S file
+ * OBS_Record() - Make the record of the observation in obs_rec
  * ======================================================================================================================
  */
-void OBS_N2S_Add() {
-  if (obs.inuse) {     // Sanity check
-    char ts[32];
-   
-    memset(obsbuf, 0, sizeof(obsbuf));
+void OBS_Record() {
+  uint32_t fields = 0;
+  uint32_t u;
+  int16_t bv = lround(obs.bv * 100);
+  int len = OBS_REC_DATA;
+  int found = 0;
+  int used = 0;
+
+  for (int f=0; f<OBS_FIELDS; f++) {
+    for (int s=0; s<MAX_SENSORS; s++) {
+      if (obs.sensor[s].inuse && !strcmp(obs.sensor[s].id, obs_fields[f].id)) {
+        int32_t l = (obs.sensor[s].type == F_OBS) ? lround(obs.sensor[s].f_obs * obs_fields[f].scale) :
+                                                    obs.sensor[s].i_obs * obs_fields[f].scale;
+
+        if (obs_fields[f].size == 2) {
+          int16_t w = (l > 32767) ? 32767 : ((l < -32768) ? -32768 : l);
+          memcpy (&obs_rec[len], &w, 2);
+        }
+        else {
+          memcpy (&obs_rec[len], &l, 4);
+        }
+        len += obs_fields[f].size;
+        fields |= (1UL << f);
+        found++;
+        break;
+      }
+    }
+  }
+
+  for (int s=0; s<MAX_SENSORS; s++) {
+    used += obs.sensor[s].inuse;
+  }
+  if (found != used) {
+    sprintf (msgbuf, "OBS:REC %d NOT IN SCHEMA", used - found);
+    Output (msgbuf);
+  }
 
-    tm *dt = gmtime(&obs.ts); 
+  obs_rec[SD_REC_LEN] = len;
+  obs_rec[SD_REC_SCHEMA] = OBS_SCHEMA;
+  memcpy (&obs_rec[OBS_REC_FIELDS], &fields, 4);
+  u = obs.ts;
+  memcpy (&obs_rec[OBS_REC_TS], &u, 4);
+  u = obs.hth;
+  memcpy (&obs_rec[OBS_REC_HTH], &u, 4);
+  memcpy (&obs_rec[OBS_REC_BV], &bv, 2);
+}
 
+/*
+ * ======================================================================================================================
+ * OBS_Render() - Render a record as a Chords URL, or as a JSON line. Returns false for a record we can not render
+ * 
+ * Chords  /measurements/url_create?key=1234&instrument_id=0&at=2022-05-17T17%3A40%3A04&bv=4.11&hth=8770 .....
+ * JSON    {"at":"2022-02-13T17:26:07","bv":4.11,"hth":0,"sg":1234.0,.....,"mt2":20.5}
+ * ======================================================================================================================
+ */
+bool OBS_Render(const uint8_t *rec, char *buf, bool url) {
+  const uint8_t *p = &rec[OBS_REC_DATA];
+  const uint8_t *end = rec + rec[SD_REC_LEN];
+  uint32_t fields, ts, hth;
+  int16_t bv;
+
+  buf[0] = 0;
+
+  if (rec[SD_REC_SCHEMA] == SD_SCHEMA_TEXT) {
+    if (url || (rec[SD_REC_LEN] < SD_REC_HDR)) {
+      return (false);
+    }
+    memcpy (buf, &rec[SD_REC_HDR], rec[SD_REC_LEN] - SD_REC_HDR);
+    buf[rec[SD_REC_LEN] - SD_REC_HDR] = 0;
+    return (true);
+  }
+  if ((rec[SD_REC_SCHEMA] != OBS_SCHEMA) || (rec[SD_REC_LEN] < OBS_REC_DATA)) {
+    return (false);
+  }
+
+  memcpy (&fields, &rec[OBS_REC_FIELDS], 4);
+  memcpy (&ts, &rec[OBS_REC_TS], 4);
+  memcpy (&hth, &rec[OBS_REC_HTH], 4);
+  memcpy (&bv, &rec[OBS_REC_BV], 2);
+
+  time_t t = ts;
+  tm *dt = gmtime(&t);
+
+  if (url) {
     // If Ethernet add additional items to be logged on a recording site like Chords.
     if (cf_ethernet_enable) {
-      sprintf (obsbuf, "%s?key=%s&instrument_id=%d", cf_urlpath, cf_apikey, cf_instrument_id);
+      sprintf (buf, "%s?key=%s&instrument_id=%d", cf_urlpath, cf_apikey, cf_instrument_id);
     }
-    
-    sprintf (obsbuf+strlen(obsbuf), "&at=%d-%02d-%02dT%02d%%3A%02d%%3A%02d",
+    sprintf (buf+strlen(buf), "&at=%d-%02d-%02dT%02d%%3A%02d%%3A%02d",
       dt->tm_year+1900, dt->tm_mon+1,  dt->tm_mday,
       dt->tm_hour, dt->tm_min, dt->tm_sec);
-      
-    sprintf (obsbuf+strlen(obsbuf), "&bv=%d.%02d",
-       (int)obs.bv, (int)(obs.bv*100)%100); 
+    sprintf (buf+strlen(buf), "&bv=%d.%02d&hth=%lu", bv/100, bv%100, (unsigned long)hth);
+  }
+  else {
+    sprintf (buf, "{\"at\":\"%d-%02d-%02dT%02d:%02d:%02d\"",
+      dt->tm_year+1900, dt->tm_mon+1,  dt->tm_mday,
+      dt->tm_hour, dt->tm_min, dt->tm_sec);
+    sprintf (buf+strlen(buf), ",\"bv\":%d.%02d,\"hth\":%lu", bv/100, bv%100, (unsigned long)hth);
+  }
 
-    // Modify System Status and Set From Need to Send file bit
-    obs.hth |= SSB_FROM_N2S; // Turn On Bit
-    sprintf (obsbuf+strlen(obsbuf), "&hth=%d", obs.hth);
-   
-    for (int s=0; s<MAX_SENSORS; s++) {
-      if (obs.sensor[s].inuse) {
-        switch (obs.sensor[s].type) {
-          case F_OBS :
-            // sprintf (obsbuf+strlen(obsbuf), "&%s=%d%%2E%d", obs.sensor[s].id, 
-            //  (int)obs.sensor[s].f_obs,  (int)(obs.sensor[s].f_obs*1000)%1000);
-            sprintf (obsbuf+strlen(obsbuf), "&%s=%.1f", obs.sensor[s].id, obs.sensor[s].f_obs);
-            break;
-          case I_OBS :
-            sprintf (obsbuf+strlen(obsbuf), "&%s=%d", obs.sensor[s].id, obs.sensor[s].i_obs);
-            break;
-          case U_OBS :
-            sprintf (obsbuf+strlen(obsbuf), "&%s=%u", obs.sensor[s].id, obs.sensor[s].i_obs);
-            break;
-          default : // Should never happen
-            Output ("WhyAmIHere?");
-            break;
-        }
+  for (int f=0; f<OBS_FIELDS; f++) {
+    if (fields & (1UL << f)) {
+      int32_t l;
+
+      if ((p + obs_fields[f].size) > end) {
+        return (false);
+      }
+      if (obs_fields[f].size == 2) {
+        int16_t w;
+        memcpy (&w, p, 2);
+        l = w;
+      }
+      else {
+        memcpy (&l, p, 4);
+      }
+      p += obs_fields[f].size;
+
+      sprintf (buf+strlen(buf), (url) ? "&%s=" : ",\"%s\":", obs_fields[f].id);
+      if (obs_fields[f].type == F_OBS) {
+        sprintf (buf+strlen(buf), "%.1f", (float) l / obs_fields[f].scale);
+      }
+      else {
+        sprintf (buf+strlen(buf), "%ld", (long) l);
       }
     }
-    Serial_writeln (obsbuf);
-    SD_NeedToSend_Add(obsbuf); // Save to N2F File
+  }
+
+  if (!url) {
+    strcat (buf, "}");
+  }
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_PutVarint() - Store v 7 bits a byte, low bits first, returns bytes used
+ * ======================================================================================================================
+ */
+int OBS_PutVarint(uint8_t *p, uint32_t v) {
+  int n = 0;
+
+  while (v >= 0x80) {
+    p[n++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  return (n);
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_GetVarint() - Read a varint stored before end, returns bytes used or 0 if it runs past end
+ * ======================================================================================================================
+ */
+int OBS_GetVarint(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+  int n = 0;
+
+  *v = 0;
+  while ((p + n < end) && (n < 5)) {
+    *v |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+    if (!(p[n++] & 0x80)) {
+      return (n);
+    }
+  }
+  return (0);
+}
+
+// Zig-zag maps small signed values to small unsigned ones, 0 -1 1 -2 to 0 1 2 3
+#define OBS_ZIGZAG(v)     (((uint32_t)(v) << 1) ^ (uint32_t)((int32_t)(v) >> 31))
+#define OBS_UNZIGZAG(u)   ((int32_t)((u) >> 1) ^ -(int32_t)((u) & 1))
+
+/*
+ * ======================================================================================================================
+ * OBS_Value() - Get or set a field value in a full record at p
+ * ======================================================================================================================
+ */
+int32_t OBS_Value(const uint8_t *p, int f) {
+  if (obs_fields[f].size == 2) {
+    int16_t w;
+    memcpy (&w, p, 2);
+    return (w);
+  }
+  int32_t l;
+  memcpy (&l, p, 4);
+  return (l);
+}
+
+void OBS_SetValue(uint8_t *p, int f, int32_t l) {
+  if (obs_fields[f].size == 2) {
+    int16_t w = l;
+    memcpy (p, &w, 2);
+  }
+  else {
+    memcpy (p, &l, 4);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_Field() - Get the value of field f from a full record, returns false if it is not there
+ * ======================================================================================================================
+ */
+bool OBS_Field(const uint8_t *rec, int f, int32_t *v) {
+  const uint8_t *p = &rec[OBS_REC_DATA];
+  uint32_t fields;
+
+  if ((rec[SD_REC_SCHEMA] != OBS_SCHEMA) || (rec[SD_REC_LEN] < OBS_REC_DATA)) {
+    return (false);
+  }
+  memcpy (&fields, &rec[OBS_REC_FIELDS], 4);
+  if (!(fields & (1UL << f))) {
+    return (false);
+  }
+  for (int i=0; i<f; i++) {
+    if (fields & (1UL << i)) {
+      p += obs_fields[i].size;
+    }
+  }
+  if ((p + obs_fields[f].size) > (rec + rec[SD_REC_LEN])) {
+    return (false);
+  }
+  *v = OBS_Value(p, f);
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_Delta() - Make a delta record in out of the full record rec from prev. Returns its length, 0 if rec needs to
+ *               be a keyframe
+ * ======================================================================================================================
+ */
+int OBS_Delta(const uint8_t *rec, const uint8_t *prev, uint32_t interval, uint8_t *out) {
+  uint32_t fields, pfields, ts, pts, hth, phth;
+  int16_t bv, pbv;
+  int len = SD_REC_HDR;
+
+  if ((rec[SD_REC_SCHEMA] != OBS_SCHEMA) || (prev[SD_REC_SCHEMA] != OBS_SCHEMA)) {
+    return (0);
+  }
+  memcpy (&fields, &rec[OBS_REC_FIELDS], 4);
+  memcpy (&pfields, &prev[OBS_REC_FIELDS], 4);
+  if (fields != pfields) {
+    return (0);
+  }
+  memcpy (&ts, &rec[OBS_REC_TS], 4);
+  memcpy (&pts, &prev[OBS_REC_TS], 4);
+  memcpy (&hth, &rec[OBS_REC_HTH], 4);
+  memcpy (&phth, &prev[OBS_REC_HTH], 4);
+  memcpy (&bv, &rec[OBS_REC_BV], 2);
+  memcpy (&pbv, &prev[OBS_REC_BV], 2);
+
+  // Worst case is 5 bytes a varint, keep clear of the end of out
+  len += OBS_PutVarint(&out[len], OBS_ZIGZAG(ts - pts - interval));
+  len += OBS_PutVarint(&out[len], hth ^ phth);
+  len += OBS_PutVarint(&out[len], OBS_ZIGZAG(bv - pbv));
+
+  int off = OBS_REC_DATA;
+  for (int f=0; f<OBS_FIELDS; f++) {
+    if (fields & (1UL << f)) {
+      if (len > (SD_REC_MAX - 5)) {
+        return (0);
+      }
+      len += OBS_PutVarint(&out[len], OBS_ZIGZAG(OBS_Value(&rec[off], f) - OBS_Value(&prev[off], f)));
+      off += obs_fields[f].size;
+    }
+  }
+
+  out[SD_REC_LEN] = len;
+  out[SD_REC_SCHEMA] = OBS_SCHEMA_DELTA;
+  return (len);
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_Undelta() - Follow the observations of a log. A delta record in rec is made into the full record, a full
+ *                 record is taken as a keyframe. prev and interval are updated. Returns false if rec is not an
+ *                 observation or can not be decoded
+ * ======================================================================================================================
+ */
+bool OBS_Undelta(uint8_t *rec, uint8_t *prev, uint32_t *interval) {
+  const uint8_t *p = &rec[SD_REC_HDR];
+  const uint8_t *end = rec + rec[SD_REC_LEN];
+  uint8_t full[SD_REC_MAX];
+  uint32_t fields, ts, hth, u;
+  int16_t bv;
+  int n;
+
+  if (rec[SD_REC_SCHEMA] == OBS_SCHEMA) {
+    memcpy (prev, rec, rec[SD_REC_LEN]);
+    *interval = 0;
+    return (true);
+  }
+  if ((rec[SD_REC_SCHEMA] != OBS_SCHEMA_DELTA) || (prev[SD_REC_SCHEMA] != OBS_SCHEMA)) {
+    return (false);
+  }
+
+  memcpy (full, prev, prev[SD_REC_LEN]);
+  memcpy (&fields, &prev[OBS_REC_FIELDS], 4);
+  memcpy (&ts, &prev[OBS_REC_TS], 4);
+  memcpy (&hth, &prev[OBS_REC_HTH], 4);
+  memcpy (&bv, &prev[OBS_REC_BV], 2);
+
+  if (!(n = OBS_GetVarint(p, end, &u))) return (false);
+  p += n;
+  u = ts + *interval + OBS_UNZIGZAG(u);
+  *interval = u - ts;
+  memcpy (&full[OBS_REC_TS], &u, 4);
+
+  if (!(n = OBS_GetVarint(p, end, &u))) return (false);
+  p += n;
+  hth ^= u;
+  memcpy (&full[OBS_REC_HTH], &hth, 4);
+
+  if (!(n = OBS_GetVarint(p, end, &u))) return (false);
+  p += n;
+  bv += OBS_UNZIGZAG(u);
+  memcpy (&full[OBS_REC_BV], &bv, 2);
+
+  int off = OBS_REC_DATA;
+  for (int f=0; f<OBS_FIELDS; f++) {
+    if (fields & (1UL << f)) {
+      if (!(n = OBS_GetVarint(p, end, &u))) return (false);
+      p += n;
+      OBS_SetValue(&full[off], f, OBS_Value(&prev[off], f) + OBS_UNZIGZAG(u));
+      off += obs_fields[f].size;
+    }
+  }
+
+  memcpy (rec, full, full[SD_REC_LEN]);
+  memcpy (prev, full, full[SD_REC_LEN]);
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_Export() - Render a day's log of records, path YYYYMMDD.obs, as JSON lines in YYYYMMDD.log next to it
+ * ======================================================================================================================
+ */
+void OBS_Export(const char *path) {
+  char out[32];
+  uint8_t rec[SD_REC_MAX];
+  uint8_t prev[SD_REC_MAX];
+  uint32_t interval = 0;
+  uint32_t skipped = 0;
+  uint32_t was = 0;
+  File in, fp;
+  int lines = 0;
+
+  prev[SD_REC_SCHEMA] = SD_SCHEMA_TEXT;  // No keyframe yet
+
+  strcpy (out, path);
+  strcpy (out + strlen(out) - 3, "log");
+
+  in = SD.open(path, FILE_READ);
+  if (in) {
+    fp = SD.open(out, FILE_WRITE);
+  }
+  if (!in || !fp) {
+    sprintf (msgbuf, "OBS:EXPORT %s ERR", out);
+    Output (msgbuf);
+    if (in) {
+      in.close();
+    }
+    return;
+  }
+
+  while (SD_ReadRecord(in, rec, &skipped)) {
+    if (skipped != was) {
+      was = skipped;
+      prev[SD_REC_SCHEMA] = SD_SCHEMA_TEXT;  // Records were lost, wait for a keyframe
+    }
+    if (rec[SD_REC_SCHEMA] != SD_SCHEMA_TEXT) {
+      OBS_Undelta(rec, prev, &interval);
+    }
+    if (OBS_Render(rec, msgbuf, false)) {
+      fp.write(msgbuf, strlen(msgbuf));
+      fp.write("\r\n", 2);
+      lines++;
+    }
+  }
+  in.close();
+  fp.close();
+
+  sprintf (msgbuf, "OBS:EXPORT %d SKIP %lu", lines, skipped);
+  Output (msgbuf);
+}
+
+/*
+ * ======================================================================================================================
+ * OBS_N2S_Add() - Save OBS to N2S file
+ * ======================================================================================================================
+ */
+void OBS_N2S_Add() {
+  if (obs.inuse) {     // Sanity check
+    uint8_t rec[SD_REC_MAX];
+    uint32_t hth;
+
+    memcpy (rec, obs_rec, obs_rec[SD_REC_LEN]);
+
+    // Modify System Status and Set From Need to Send file bit
+    memcpy (&hth, &rec[OBS_REC_HTH], 4);
+    hth |= SSB_FROM_N2S; // Turn On Bit
+    memcpy (&rec[OBS_REC_HTH], &hth, 4);
+
+    SD_NeedToSend_Add(rec); // Save to N2F File
     Output("OBS-> N2S");
   }
   else {
@@ -126,54 +634,51 @@ void OBS_N2S_Add() {
 
 /*
  * ======================================================================================================================
- * OBS_LOG_Add() - Create observation in obsbuf and save to SD card.
+ * OBS_LOG_Add() - Save the observation to SD card as a delta from the last one or a keyframe, and show it as JSON
  * 
- * {"at":"2022-02-13T17:26:07","css":18,"hth":0,"bcs":2,"bpc":63.2695,.....,"mt2":20.5625}
+ * {"at":"2022-02-13T17:26:07","bv":4.11,"hth":0,"sg":1234.0,.....,"mt2":20.5}
  * ======================================================================================================================
  */
 void OBS_LOG_Add() {
   Output("OBS_ADD()");
     
   if (obs.inuse) {     // Sanity check
+    uint8_t rec[SD_REC_MAX];
+    uint8_t check[SD_REC_MAX];
+    uint8_t prev[SD_REC_MAX];
+    uint32_t interval = obs_log_interval;
+    int len = 0;
 
-    memset(obsbuf, 0, sizeof(obsbuf));
+    OBS_Render(obs_rec, obsbuf, false);
 
-    // Save the Observation in JSON format
-    
-    sprintf (obsbuf, "{");
+    Output("OBS->SD");
+    Serial_writeln (obsbuf);
 
-    tm *dt = gmtime(&obs.ts); 
-    
-    sprintf (obsbuf+strlen(obsbuf), "\"at\":\"%d-%02d-%02dT%02d:%02d:%02d\"",
-      dt->tm_year+1900, dt->tm_mon+1,  dt->tm_mday,
-      dt->tm_hour, dt->tm_min, dt->tm_sec);
-      
-    sprintf (obsbuf+strlen(obsbuf), ",\"bv\":%d.%02d", (int)obs.bv, (int)(obs.bv*100)%100); 
-    sprintf (obsbuf+strlen(obsbuf), ",\"hth\":%d", obs.hth);
-    
-    for (int s=0; s<MAX_SENSORS; s++) {
-      if (obs.sensor[s].inuse) {
-        switch (obs.sensor[s].type) {
-          case F_OBS :
-            sprintf (obsbuf+strlen(obsbuf), ",\"%s\":%.1f", obs.sensor[s].id, obs.sensor[s].f_obs);
-            break;
-          case I_OBS :
-            sprintf (obsbuf+strlen(obsbuf), ",\"%s\":%d", obs.sensor[s].id, obs.sensor[s].i_obs);
-            break;
-          case U_OBS :
-            sprintf (obsbuf+strlen(obsbuf), ",\"%s\":%u", obs.sensor[s].id, obs.sensor[s].i_obs);
-            break;
-          default : // Should never happen
-            Output ("WhyAmIHere?");
-            break;
-        }
+    if (SD_LogOpen() && !SD_log_keyframe && (obs_log_deltas < OBS_KEYFRAME)) {
+      len = OBS_Delta(obs_rec, obs_log_prev, obs_log_interval, rec);
+    }
+
+    // Decode the delta the way a reader of the log will, use a keyframe if it does not give back the observation
+    if (len) {
+      memcpy (check, rec, len);
+      memcpy (prev, obs_log_prev, obs_log_prev[SD_REC_LEN]);
+      if (!OBS_Undelta(check, prev, &interval) || memcmp(check, obs_rec, obs_rec[SD_REC_LEN])) {
+        len = 0;
       }
     }
-    sprintf (obsbuf+strlen(obsbuf), "}");
-    
-    Output("OBS->SD");
-    Serial_writeln (obsbuf);
-    SD_LogObservation(obsbuf); 
+
+    if (len) {
+      SD_LogRecord(rec);
+      obs_log_interval = interval;
+      obs_log_deltas++;
+    }
+    else {
+      SD_LogRecord(obs_rec);
+      obs_log_interval = 0;
+      obs_log_deltas = 0;
+      SD_log_keyframe = false;
+    }
+    memcpy (obs_log_prev, obs_rec, obs_rec[SD_REC_LEN]);
   }
   else {
     Output("OBS->SD OBS:Empty");
@@ -182,47 +687,14 @@ void OBS_LOG_Add() {
 
 /*
  * ======================================================================================================================
- * OBS_Build() - Create observation in obsbuf for sending to Chords
- * 
- * Example at=2022-05-17T17%3A40%3A04&hth=8770 .....
+ * OBS_Build() - Render the observation record in obsbuf for sending to Chords. With http_post obsbuf already has the
+ *               JSON line OBS_LOG_Add() rendered, it is sent as it is.
  * ======================================================================================================================
  */
 bool OBS_Build() {  
   if (obs.inuse) {     // Sanity check  
-    memset(obsbuf, 0, sizeof(obsbuf));
-
-    tm *dt = gmtime(&obs.ts); 
-
-    // If Ethernet add additional items to be logged on a recording site like Chords.
-    if (cf_ethernet_enable) {
-      sprintf (obsbuf, "%s?key=%s&instrument_id=%d", cf_urlpath, cf_apikey, cf_instrument_id);
-    }
-    
-    sprintf (obsbuf+strlen(obsbuf), "at=%d-%02d-%02dT%02d%%3A%02d%%3A%02d",
-      dt->tm_year+1900, dt->tm_mon+1,  dt->tm_mday,
-      dt->tm_hour, dt->tm_min, dt->tm_sec);
-
-    sprintf (obsbuf+strlen(obsbuf), "&bv=%d.%02d",
-       (int)obs.bv, (int)(obs.bv*100)%100); 
-    sprintf (obsbuf+strlen(obsbuf), "&hth=%d", obs.hth);
-    
-    for (int s=0; s<MAX_SENSORS; s++) {
-      if (obs.sensor[s].inuse) {
-        switch (obs.sensor[s].type) {
-          case F_OBS :
-            sprintf (obsbuf+strlen(obsbuf), "&%s=%.1f", obs.sensor[s].id, obs.sensor[s].f_obs);
-            break;
-          case I_OBS :
-            sprintf (obsbuf+strlen(obsbuf), "&%s=%d", obs.sensor[s].id, obs.sensor[s].i_obs);
-            break;
-          case U_OBS :
-            sprintf (obsbuf+strlen(obsbuf), "&%s=%u", obs.sensor[s].id, obs.sensor[s].i_obs);
-            break;
-          default : // Should never happen
-            Output ("WhyAmIHere?");
-            break;
-        }
-      }
+    if (!cf_http_post) {
+      OBS_Render(obs_rec, obsbuf, true);
     }
 
     Output("OBSBLD:OK");
@@ -272,8 +744,13 @@ void OBS_Take() {
 
   obs.bv = vbat_get();
 
+  strcpy (obs.sensor[sidx].id, "sq");
+  obs.sensor[sidx].type = I_OBS;
+  obs.sensor[sidx].i_obs = NVM_SeqNext((obs.ts > NVM_SEQ_EPOCH) ? (obs.ts - NVM_SEQ_EPOCH) : 0);
+  obs.sensor[sidx++].inuse = true;
+
   //
-  // Distance Sensor - Take multiple readings and return the median, 15s spent reading guage
+  // Distance Sensor - Median of the scheduled sub-samples, or of a 15s burst of readings if we don't have them
   //
   strcpy (obs.sensor[sidx].id, "sg");          // snow or stream gauge
   obs.sensor[sidx].type = F_OBS;
@@ -458,6 +935,42 @@ void OBS_Take() {
     obs.sensor[sidx].f_obs = h;
     obs.sensor[sidx++].inuse = true;
   }
+
+  // Last N2S drain, records sent and left and the smoothed send time
+  if ((obs_n2s_sent >= 0) && (sidx < MAX_SENSORS-3)) {
+    strcpy (obs.sensor[sidx].id, "n2sn");
+    obs.sensor[sidx].type = I_OBS;
+    obs.sensor[sidx].i_obs = obs_n2s_sent;
+    obs.sensor[sidx++].inuse = true;
+
+    strcpy (obs.sensor[sidx].id, "n2sb");
+    obs.sensor[sidx].type = I_OBS;
+    obs.sensor[sidx].i_obs = obs_n2s_left;
+    obs.sensor[sidx++].inuse = true;
+
+    strcpy (obs.sensor[sidx].id, "n2sr");
+    obs.sensor[sidx].type = I_OBS;
+    obs.sensor[sidx].i_obs = obs_n2s_rtt;
+    obs.sensor[sidx++].inuse = true;
+
+    obs_n2s_sent = -1;
+  }
+
+  // Wake cycle profile, phase times in ms and energy of the last closed cycle. Phases stop a slot short so pmas fits.
+  if ((cf_profile == 2) && prof_valid && (sidx < MAX_SENSORS-1)) {
+    for (int p=0; (p<PROF_PHASES) && (sidx<MAX_SENSORS-2); p++) {
+      sprintf (obs.sensor[sidx].id, "p%s", prof_id[p]);
+      obs.sensor[sidx].type = I_OBS;
+      obs.sensor[sidx].i_obs = prof_ms[p];
+      obs.sensor[sidx++].inuse = true;
+    }
+    strcpy (obs.sensor[sidx].id, "pmas");
+    obs.sensor[sidx].type = F_OBS;
+    obs.sensor[sidx].f_obs = prof_mas;
+    obs.sensor[sidx++].inuse = true;
+  }
+
+  OBS_Record();
   
   Output("OBS_TAKE(DONE)");
 }
@@ -470,52 +983,286 @@ void OBS_Take() {
 void OBS_Do() {
   Output("OBS_DO()");
   
+  PROF_Begin(PROF_TAKE);
   I2C_Check_Sensors(); // Make sure Sensors are online
 
   OBS_Take();          // Take an observation
+  PROF_End(PROF_TAKE);
 
   // At this point, the obs data structure has been filled in with observation data
+  PROF_Begin(PROF_LOG);
   OBS_LOG_Add();        // Save Observation Data to Log file.
+  PROF_End(PROF_LOG);
 
-  // If we have a Ethernet Card Send OBS 
-  if (cf_ethernet_enable) {
+  // If we have a Ethernet Card Send OBS, unless the power policy has us sending in batches or not at all
+  if (cf_ethernet_enable && (pwr_tiers[pwr_tier].send != PWR_SEND_NOW)) {
+    Output("OBS->N2S PWR");
+    OBS_N2S_Save();
+  }
+  else if (cf_ethernet_enable) {
     // Build Observation to Send
+    PROF_Begin(PROF_SEND);
     Output("OBS_BUILD()");
     OBS_Build();
 
     Output("OBS_SEND()");
-    if (OBS_Send(obsbuf) != 1) {  
+    int send_result = OBS_Send(obs_rec, obsbuf);
+    PROF_End(PROF_SEND);
+    if (send_result != 1) {  
       Output("FS->PUB FAILED");
       OBS_N2S_Save(); // Saves Main observations
     }
     else {
-      bool OK2Send = true;
-        
       Output("FS->PUB OK");
+      // Any N2S observations are sent by the scheduler's N2S task
+    }
+  }
+
+  SD_Stats();  // Card blocks this observation cost
+  BUS_Stats(); // SPI bus time per device
+  if (cf_ethernet_enable) {
+    UDP_Stats(); // Energy per delivered observation by transport
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * OBS_N2S_Mark() - Mark index entry i as sent
+ *=======================================================================================================================
+ */
+void OBS_N2S_Mark(File &ix, int32_t i, uint32_t entry) {
+  entry |= SD_N2S_SENT;
+  ix.seek(i * 4);
+  ix.write((uint8_t *) &entry, 4);
+}
+
+/* 
+ *=======================================================================================================================
+ * OBS_N2S_PubAck() - Wait up to timeout ms for a PUBACK and mark the record it is for sent. Returns 1 when a record
+ *                    was marked, 0 for a PUBACK not in flight, -1 when none came
+ *=======================================================================================================================
+ */
+int OBS_N2S_PubAck(File &ix, unsigned long timeout) {
+  uint16_t id;
+  unsigned long ms;
+
+  if (MQTT_Read(timeout, &id) != MQTT_PUBACK) {
+    return (-1);
+  }
+
+  // Publishes are acknowledged in order, but one from a connection we gave up on may still come in
+  for (int f=0; f<obs_n2s_flying; f++) {
+    if (obs_n2s_flight[f].id == id) {
+      ms = millis() - obs_n2s_flight[f].t0;
+      obs_n2s_rtt = (obs_n2s_rtt) ? (obs_n2s_rtt * 3 + ms) / 4 : ms;
+      OBS_N2S_Mark(ix, obs_n2s_flight[f].i, obs_n2s_flight[f].entry);
+      obs_n2s_flight[f] = obs_n2s_flight[--obs_n2s_flying];
+      return (1);
+    }
+  }
+  return (0);
+}
+
+/* 
+ *=======================================================================================================================
+ * OBS_N2S_Refused() - Keep a note in the log of the N2S record rec the server would not take
+ *=======================================================================================================================
+ */
+void OBS_N2S_Refused(const uint8_t *rec) {
+  int32_t sq;
+
+  sprintf (msgbuf, "{\"n2s\":500,\"sq\":%ld}", OBS_Field(rec, OBS_FIELD_SQ, &sq) ? (long) sq : -1L);
+  SD_LogText (msgbuf);
+}
+
+/* 
+ *=======================================================================================================================
+ * OBS_N2S_Body() - Write the JSON body of batch records first to first+n-1 to out, or NULL to count it, gzipped
+ *                  when gzip. Each record is rendered again from the card as it is written. Returns the length, 0 if
+ *                  a record is not what it was when the batch was made.
+ *=======================================================================================================================
+ */
+uint32_t OBS_N2S_Body(File &fp, int first, int n, Print *out, bool gzip) {
+  uint8_t rec[SD_REC_MAX];
+  uint32_t skipped = 0;
+  uint32_t len;
+  bool same = true;
+
+  GZ_Begin(out, gzip);
+  GZ_Write(obsbuf, Ethernet_PostHead(obsbuf));
+  for (int b=first; b<first+n; b++) {
+    fp.seek(obs_n2s_batch[b].entry);
+    if (!SD_ReadRecord(fp, rec, &skipped) || !OBS_Render(rec, obsbuf, false) ||
+        (strlen(obsbuf) != obs_n2s_batch[b].len)) {
+      same = false;
+      break;
+    }
+    if (b != first) {
+      GZ_Write(",", 1);
+    }
+    GZ_Write(obsbuf, obs_n2s_batch[b].len);
+  }
+  GZ_Write(ETH_POST_TAIL, strlen(ETH_POST_TAIL));
+  len = GZ_End();
+  return ((same) ? len : 0);
+}
 
-      // Check if we have any N2S only if we have not added to the file while trying to send OBS
-      if (OK2Send) {
-        OBS_N2S_Publish(); 
+/* 
+ *=======================================================================================================================
+ * OBS_N2S_PostBody() - POST batch records first to first+n-1 as one JSON body, returns the send result. With
+ *                      http_gzip a body of more than one record is gzipped, and compressed once first to find its
+ *                      length. Otherwise the length is from when the batch was made.
+ *=======================================================================================================================
+ */
+int OBS_N2S_PostBody(File &fp, int first, int n) {
+  bool gzip = cf_http_gzip && (n > 1);
+  uint32_t len;
+
+  if (gzip) {
+    len = OBS_N2S_Body(fp, first, n, NULL, gzip);
+  }
+  else {
+    len = Ethernet_PostHead(obsbuf) + strlen(ETH_POST_TAIL) + (n - 1);  // Commas between the records
+    for (int b=first; b<first+n; b++) {
+      len += obs_n2s_batch[b].len;
+    }
+  }
+
+  if (!len || !Ethernet_PostBegin(len, gzip)) {
+    return (0);
+  }
+  if (OBS_N2S_Body(fp, first, n, &client, gzip) != len) {
+    // The card gave us something else than before, the server did not get its Content-Length and we do not count
+    // it sent
+    client.stop();
+    return (0);
+  }
+  return (Ethernet_Response());
+}
+
+/* 
+ *=======================================================================================================================
+ * OBS_N2S_Post() - POST the n records in the batch and mark the ones the server takes or refuses with a 500. After a
+ *                  500 they go again one at a time to find the one it refused. Returns the records marked, n unless
+ *                  sending failed.
+ *=======================================================================================================================
+ */
+int OBS_N2S_Post(File &fp, File &ix, int n) {
+  uint8_t rec[SD_REC_MAX];
+  uint32_t skipped = 0;
+  unsigned long t0 = millis();
+  unsigned long ms;
+  int result;
+  int marked = 0;
+  bool single;
+
+  result = OBS_N2S_PostBody(fp, 0, n);
+  ms = millis() - t0;
+  obs_n2s_rtt = (obs_n2s_rtt) ? (obs_n2s_rtt * 3 + ms) / 4 : ms;
+
+  single = (result == -500) && (n > 1);
+  for (int b=0; b<n; b++) {
+    if (single) {
+      result = OBS_N2S_PostBody(fp, b, 1);
+    }
+    if (result == -500) {
+      fp.seek(obs_n2s_batch[b].entry);
+      if (SD_ReadRecord(fp, rec, &skipped)) {
+        OBS_N2S_Refused(rec);
       }
+      Output ("OBS:N2S->ERR:500");
+    }
+    else if (result != 1) {
+      break;
     }
+    OBS_N2S_Mark(ix, obs_n2s_batch[b].i, obs_n2s_batch[b].entry);
+    marked++;
+  }
+  return (marked);
+}
+
+/* 
+ *=======================================================================================================================
+ * OBS_N2S_Order() - Index entry to try nth when draining count entries, -1 after the last
+ *=======================================================================================================================
+ */
+int32_t OBS_N2S_Order(uint32_t n, uint32_t count) {
+  uint32_t coarse;
+
+  switch (cf_n2s_drain) {
+    case OBS_N2S_LIFO :
+      return ((n < count) ? (int32_t)(count - 1 - n) : -1);
+
+    case OBS_N2S_DECIMATE :
+      // Newest and every Nth back from it, then fill the gaps newest first. Each entry comes once, the gaps are
+      // counted back from the newest with every Nth left out. cf_n2s_decimate is at least 2.
+      coarse = (count + cf_n2s_decimate - 1) / cf_n2s_decimate;
+      if (n < coarse) {
+        return (count - 1 - (n * cf_n2s_decimate));
+      }
+      n -= coarse;
+      return ((n < count - coarse) ? (int32_t)(count - 2 - n - (n / (cf_n2s_decimate - 1))) : -1);
+
+    default :
+      return ((n < count) ? (int32_t) n : -1);
   }
 }
 
 /* 
  *=======================================================================================================================
- * OBS_N2S_Publish()
+ * OBS_N2S_Pending() - True when index entry i is in the POST batch being made or waiting for its PUBACK
+ *=======================================================================================================================
+ */
+bool OBS_N2S_Pending(int32_t i, int batch) {
+  for (int b=0; b<batch; b++) {
+    if (obs_n2s_batch[b].i == i) {
+      return (true);
+    }
+  }
+  for (int f=0; f<obs_n2s_flying; f++) {
+    if (obs_n2s_flight[f].i == i) {
+      return (true);
+    }
+  }
+  return (false);
+}
+
+/* 
+ *=======================================================================================================================
+ * OBS_N2S_Publish() - Send N2S records in the order of cf_n2s_drain for up to the time SCH_N2S_Budget() gives the
+ *                     backlog. Each record is marked in
+ *                     the N2S index once sent, or skipped after a 500, and both files are deleted when every record
+ *                     is marked. A record is not started unless the smoothed send time says it will finish within
+ *                     the budget, and sends are spaced by half the smoothed send time, so a slow server is given
+ *                     more room.
+ *
+ *                     With an MQTT broker the records are published one after the other over one connection with
+ *                     up to MQTT_WINDOW waiting for their PUBACK, which marks them, and there is no spacing.
+ *                     With http_post and no MQTT or UDP they go http_batch at a time in one JSON POST.
  *=======================================================================================================================
  */
 void OBS_N2S_Publish() {
-  File fp;
-  char ch;
-  int i;
+  File fp, ix;
+  uint8_t rec[SD_REC_MAX];
+  uint32_t skipped = 0;
+  uint32_t count = 0;
+  uint32_t left = 0;
+  uint32_t entry, was, budget_ms;
+  unsigned long start = millis();
+  unsigned long t0, ms;
+  int32_t i = -1;
+  int32_t sq;
   int sent=0;
+  int acked, marked;
+  int batch = 0;
+  bool mqtt, post;
 
   memset(obsbuf, 0, sizeof(obsbuf));
 
   Output ("OBS:N2S Publish");
 
+  SD_Sync();  // The append handle is open, get its size and data onto the card before we read
+
   if (SD_exists && SD.exists(SD_n2s_file)) {
     Output ("OBS:N2S:Exists");
 
@@ -523,117 +1270,178 @@ void OBS_N2S_Publish() {
 
     if (fp) {
       // Delete Empty File or too small of file to be valid
-      if (fp.size()<=20) {
+      if (fp.size() < OBS_REC_DATA) {
         fp.close();
         Output ("OBS:N2S:Empty");
         SD_N2S_Delete();
+        return;
       }
-      else {
-        if (n2sfp) {
-          if (fp.size()<=n2sfp) {
-            // Something wrong. Can not have a file position that is larger than the file
-            n2sfp = 0; 
-          }
-          else {
-            fp.seek(n2sfp);  // Seek to where we left off last time. 
+
+      ix = SD_N2S_Index(fp, &count);
+      if (!ix) {
+        fp.close();
+        Output ("OBS:N2S->IDX:ERR");
+        return;
+      }
+
+      // Backlog is the entries not marked yet
+      ix.seek(0);
+      for (uint32_t e=0; e<count; e++) {
+        ix.read(&entry, 4);
+        left += !(entry & SD_N2S_SENT);
+      }
+      budget_ms = SCH_N2S_Budget(left);
+      sprintf (msgbuf, "OBS:N2S BUDGET %lums LEFT %lu RTT %lums", (unsigned long) budget_ms, (unsigned long) left,
+        (unsigned long) obs_n2s_rtt);
+      Output (msgbuf);
+
+      obs_n2s_flying = 0;
+      mqtt = cf_mqtt_broker[0] && left && MQTT_Connect();
+      post = cf_http_post && !mqtt && !cf_udp_collector[0];
+
+      // Loop through each record / obs and transmit
+      for (uint32_t n=0; (i = OBS_N2S_Order(n, count)) >= 0; n++) {
+        // Millis() math is unsigned so it is right across the rollover
+        if (((millis() - start) + obs_n2s_rtt) > budget_ms) {
+          // need to break out so new obs can be made, or we have used the energy this tier allows
+          Output ("OBS:N2S->TIME2EXIT");
+          break;
+        }
+
+        // Not marked until its POST or PUBACK, so one on its way is passed over too
+        ix.seek(i * 4);
+        ix.read(&entry, 4);
+        if ((entry & SD_N2S_SENT) || OBS_N2S_Pending(i, batch)) {
+          continue;
+        }
+
+        // The index only has good frames, one that has gone bad since is passed over
+        fp.seek(entry);
+        was = skipped;
+        if (!SD_ReadRecord(fp, rec, &skipped) || (skipped != was) ||
+            !OBS_Render(rec, (mqtt) ? MQTT_Payload() : obsbuf, !mqtt && !cf_http_post)) {
+          // Not an observation we can send, move past it
+          OBS_N2S_Mark(ix, i, entry);
+          continue;
+        }
+
+        if (mqtt) {
+          // Only wait for a PUBACK when the window is full
+          while ((obs_n2s_flying == MQTT_WINDOW) && ((acked = OBS_N2S_PubAck(ix, MQTT_TIMEOUT)) >= 0)) {
+            sent += acked;
+            left -= acked;
           }
-        } 
-
-        // Loop through each line / obs and transmit
-        
-        // set timer on when we need to stop sending n2s obs
-        uint64_t TimeFromNow = millis() + (10 * 60000);; // Allow 10 minutes of sending N2S.
-        
-        i = 0;
-        while (fp.available() && (i < MAX_MSGBUF_SIZE )) {
-          ch = fp.read();
-
-          if (ch == 0x0A) {  // newline
-            int send_result = OBS_Send(obsbuf);
-            if (send_result == 1) { 
-              sprintf (Buffer32Bytes, "OBS:N2S[%d]->PUB:OK", sent++);
-              Output (Buffer32Bytes);
-              Serial_writeln (obsbuf);
-
-              // setup for next line in file
-              i = 0;
-
-              // file position is at the start of the next observation or at eof
-              n2sfp = fp.position();
-
-              delay(1000); // Add some between sending
-              
-              sprintf (Buffer32Bytes, "OBS:N2S[%d] Contunue", sent);
-              Output (Buffer32Bytes); 
-
-              if(millis() > TimeFromNow) {
-                // need to break out so new obs can be made
-                Output ("OBS:N2S->TIME2EXIT");
-                break;                
-              }
-            }
-            
-            if (send_result == -500) { // HTTP/1.1 500 Internal Server Error
-              // Suspect we have a bad N2S observation that webserver does not like, move past it.
-              sprintf (Buffer32Bytes, "OBS:N2S[%d]->ERR:500", sent++);
-              Output (Buffer32Bytes);
-              Serial_writeln (obsbuf);
-
-              // setup for next line in file
-              i = 0;
-
-              // file position is at the start of the next observation or at eof
-              n2sfp = fp.position();
-              
-              sprintf (Buffer32Bytes, "OBS:N2S[%d] Contunue", sent);
-              Output (Buffer32Bytes); 
-
-              if(millis() > TimeFromNow) {
-                // need to break out so new obs can be made
-                Output ("OBS:N2S->TIME2EXIT");
-                break;                
-              }             
-            }
-            else {
-                sprintf (Buffer32Bytes, "OBS:N2S[%d]->PUB:ERR", sent);
-                Output (Buffer32Bytes);
-                // On transmit failure, stop processing file.
-                break;
-            }
-            
-            // At this point file pointer's position is at the first character of the next line or at eof
-            
-          } // Newline
-          else if (ch == 0x0D) { // CR, LF follows and will trigger the line to be processed       
-            obsbuf[i] = 0; // null terminate then wait for newline to be read to process OBS
+          if ((obs_n2s_flying == MQTT_WINDOW) || !MQTT_Publish(&obs_n2s_flight[obs_n2s_flying].id)) {
+            Output ("OBS:N2S->MQTT:ERR");
+            break;
           }
-          else {
-            obsbuf[i++] = ch;
+          obs_n2s_flight[obs_n2s_flying].i = i;
+          obs_n2s_flight[obs_n2s_flying].entry = entry;
+          obs_n2s_flight[obs_n2s_flying].t0 = millis();
+          obs_n2s_flying++;
+
+          // Take in the PUBACKs that are here already
+          while (mqtt_client.available() && ((acked = OBS_N2S_PubAck(ix, MQTT_TIMEOUT)) >= 0)) {
+            sent += acked;
+            left -= acked;
           }
+          continue;
+        }
 
-          // Check for buffer overrun
-          if (i >= MAX_MSGBUF_SIZE) {
-            sprintf (Buffer32Bytes, "OBS:N2S[%d]->BOR:ERR", sent);
-            Output (Buffer32Bytes);
-            fp.close();
-            SD_N2S_Delete(); // Bad data in the file so delete the file           
-            return;
+        if (post) {
+          obs_n2s_batch[batch].i = i;
+          obs_n2s_batch[batch].entry = entry;
+          obs_n2s_batch[batch].len = strlen(obsbuf);
+          if (++batch < cf_http_batch) {
+            continue;
+          }
+          marked = OBS_N2S_Post(fp, ix, batch);
+          sent += marked;
+          left -= marked;
+          if (marked < batch) {
+            Output ("OBS:N2S->POST:ERR");
+            break;
           }
-        } // end while 
+          batch = 0;
 
-        if (fp.available() <= 20) {
-          // If at EOF or some invalid amount left then delete the file
-          fp.close();
-          SD_N2S_Delete();
+          delay (OBS_N2S_Gap());
+          continue;
+        }
+        bool has_sq = OBS_Field(rec, OBS_FIELD_SQ, &sq);
+
+        t0 = millis();
+        int send_result = OBS_Send(rec, obsbuf);
+        ms = millis() - t0;
+        obs_n2s_rtt = (obs_n2s_rtt) ? (obs_n2s_rtt * 3 + ms) / 4 : ms;
+
+        if (send_result == 1) { 
+          sprintf (Buffer32Bytes, "OBS:N2S[%d]->PUB:OK", sent++);
+          Output (Buffer32Bytes);
+          Serial_writeln (obsbuf);
+
+          OBS_N2S_Mark(ix, i, entry);
+          left--;
+        }
+        else if (send_result == -500) { // HTTP/1.1 500 Internal Server Error
+          // Suspect we have a bad N2S observation that webserver does not like, move past it.
+          sprintf (msgbuf, "OBS:N2S[%d]->ERR:500 SQ%ld", sent++, has_sq ? (long) sq : -1L);
+          Output (msgbuf);
+          Serial_writeln (obsbuf);
+
+          OBS_N2S_Refused(rec);
+
+          OBS_N2S_Mark(ix, i, entry);
+          left--;
         }
         else {
-          // At this point we sent 0 or more observations but there was a problem.
-          // n2sfp was maintained in the above read loop. So we will close the
-          // file and next time this function is called we will seek to n2sfp
-          // and start processing from there forward. 
-          fp.close();
+            sprintf (Buffer32Bytes, "OBS:N2S[%d]->PUB:ERR", sent);
+            Output (Buffer32Bytes);
+            // On transmit failure, stop processing file.
+            break;
+        }
+
+        // Add some between sending
+        delay (OBS_N2S_Gap());
+      } // end for 
+
+      // The last batch, left for next time when we stopped early
+      if (batch && (i < 0)) {
+        marked = OBS_N2S_Post(fp, ix, batch);
+        sent += marked;
+        left -= marked;
+        if (marked == batch) {
+          batch = 0;
         }
       }
+
+      // The PUBACKs still to come
+      while (obs_n2s_flying && ((acked = OBS_N2S_PubAck(ix, MQTT_TIMEOUT)) >= 0)) {
+        sent += acked;
+        left -= acked;
+      }
+      if (obs_n2s_flying) {
+        // Not marked, a later drain publishes them again
+        sprintf (msgbuf, "OBS:N2S NO PUBACK %d", obs_n2s_flying);
+        Output (msgbuf);
+        mqtt_client.stop();
+      }
+
+      ix.close();
+      fp.close();
+
+      ms = millis() - start;
+      obs_n2s_sent = sent;
+      obs_n2s_left = left;
+      sprintf (msgbuf, "OBS:N2S SENT %d LEFT %lu %lums %lu/min", sent, (unsigned long) left, ms,
+        (ms) ? (unsigned long)((uint64_t) sent * 60000 / ms) : 0UL);
+      Output (msgbuf);
+
+      if ((i < 0) && !obs_n2s_flying && !batch) {
+        // Every record has been marked, delete the files
+        SD_N2S_Delete();
+      }
+      // Otherwise we sent 0 or more observations but there was a problem. The index has what was sent, next
+      // time this function is called the drain order is worked out again over the records still to send.
     }
     else {
         Output ("OBS:N2S->OPEN:ERR");
@@ -273,14 +273,16 @@ void Serial_Initialize() {
 
   // There are libraries that print to Serial Console so we need to initialize no mater what the jumper is set to.
   Serial.begin(9600);
-  delay(1000); // prevents usb driver crash on startup, do not omit this
+  if (!ResetBoot) {
+    delay(1000); // prevents usb driver crash on startup, do not omit this except to recover from a reset
+  }
 
   if (SerialConsoleEnabled) {
     // Wait for serial port to be available
-    if (!Serial) {
+    if (!Serial && !FastBoot) {
       OLED_write("Wait4 Serial Console");
     }
-    int countdown=60; // Wait N seconds for serial connection, then move on.
+    int countdown=(FastBoot) ? 0 : 60; // Wait N seconds for serial connection, then move on. Not after a brownout.
     while (!Serial && countdown) {
       Blink(1, 1000);
       countdown--;
@@ -0,0 +1,148 @@
+/*
+ * ======================================================================================================================
+ *  PROF.h - Wake Cycle Profiler
+ *
+ *  Times the phases of each 15m cycle with micros() and turns them into an energy estimate (mA*s) using the board
+ *  current plus the W5500 figures from the Power Dissipation table in ETH.h. A cycle is closed at the start of each
+ *  observation. The closed cycle is written to a daily profile log, /OBS/YYYY/MM/YYYYMMDD.prf, and can be added to
+ *  the observation.
+ *
+ *  micros() does not run in standby, so sleep time is taken from the RTC.
+ * ======================================================================================================================
+ */
+
+// Board current estimates in mA, excluding the W5500
+#define PROF_MA_BOARD      20.0     // SAMD21 at 48MHz, OLED on, SD idle
+#define PROF_MA_QUIET      8.0      // SAMD21 at 48MHz, OLED off
+#define PROF_MA_STANDBY    0.5      // SAMD21 standby, DS3231, regulators
+
+// W5500 current in mA from ETH.h
+#define PROF_MA_ETH_TX     132.0    // 100M Transmitting
+#define PROF_MA_ETH_LINK   128.0    // 100M Link
+#define PROF_MA_ETH_UNLINK 65.0     // Un-Link (Auto-negotiation mode)
+#define PROF_MA_ETH_PD     13.0     // Power Down mode
+
+typedef enum {
+  PROF_WAKE,       // OLED wake and PHY power up until link
+  PROF_TAKE,       // Sensor check and OBS_Take()
+  PROF_LOG,        // OBS_LOG_Add()
+  PROF_SEND,       // OBS_Build() and OBS_Send()
+  PROF_N2S,        // OBS_N2S_Publish()
+  PROF_DHCP,       // Ethernet_Renew_DHCP()
+  PROF_QUIET,      // Quiet scheduler tasks, gauge sub-samples and sensor hot-plug checks
+  PROF_SLEEP,      // Standby between tasks
+  PROF_PHASES
+} PROF_PHASE;
+
+const char *prof_id[PROF_PHASES] = {"wk", "tk", "lg", "sn", "ns", "dh", "qt", "sl"};
+
+const float prof_ma[PROF_PHASES] = {
+  PROF_MA_BOARD + PROF_MA_ETH_UNLINK,
+  PROF_MA_BOARD + PROF_MA_ETH_LINK,
+  PROF_MA_BOARD + PROF_MA_ETH_LINK,
+  PROF_MA_BOARD + PROF_MA_ETH_TX,
+  PROF_MA_BOARD + PROF_MA_ETH_TX,
+  PROF_MA_BOARD + PROF_MA_ETH_TX,
+  PROF_MA_QUIET + PROF_MA_ETH_PD,
+  PROF_MA_STANDBY + PROF_MA_ETH_PD
+};
+
+unsigned long prof_start[PROF_PHASES];   // micros() when the phase was started
+uint64_t prof_us[PROF_PHASES];           // Time accumulated in the current cycle
+unsigned long prof_ms[PROF_PHASES];      // Last closed cycle
+float prof_mas = 0.0;                    // Last closed cycle energy
+bool prof_valid = false;                 // Set once a full cycle has been closed
+
+/*
+ * ======================================================================================================================
+ * PROF_Begin() - Start timing a phase
+ * ======================================================================================================================
+ */
+void PROF_Begin(PROF_PHASE p) {
+  prof_start[p] = micros();
+}
+
+/*
+ * ======================================================================================================================
+ * PROF_End() - Stop timing a phase and add it to the current cycle
+ * ======================================================================================================================
+ */
+void PROF_End(PROF_PHASE p) {
+  prof_us[p] += (unsigned long)(micros() - prof_start[p]);  // Unsigned math handles the micros() rollover
+}
+
+/*
+ * ======================================================================================================================
+ * PROF_Sleep() - Add seconds spent in standby to the current cycle
+ * ======================================================================================================================
+ */
+void PROF_Sleep(uint32_t seconds) {
+  prof_us[PROF_SLEEP] += (uint64_t) seconds * 1000000;
+}
+
+/*
+ * ======================================================================================================================
+ * PROF_Log() - Save the closed cycle to the daily profile log
+ *
+ * {"at":"2022-02-13T17:30:00","wk":[2310,196.1],"tk":[512,75.8],....,"mas":2561.3}
+ * ======================================================================================================================
+ */
+void PROF_Log() {
+  char SD_proffile[13];
+  File fp;
+
+  if (!SD_exists || !RTC_valid || !SD_ObsDir(now.year(), now.month())) {
+    return;
+  }
+
+  sprintf (SD_proffile, "%4d%02d%02d.prf", now.year(), now.month(), now.day());
+
+  sprintf (msgbuf, "{\"at\":\"%d-%02d-%02dT%02d:%02d:%02d\"",
+    now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second());
+  for (int p=0; p<PROF_PHASES; p++) {
+    sprintf (msgbuf+strlen(msgbuf), ",\"%s\":[%lu,%.1f]", prof_id[p], prof_ms[p], prof_ms[p] * prof_ma[p] / 1000.0);
+  }
+  sprintf (msgbuf+strlen(msgbuf), ",\"mas\":%.1f}", prof_mas);
+
+  fp = SD.open(SD_monthdir, SD_proffile, FILE_WRITE);
+  if (fp) {
+    fp.println(msgbuf);
+    fp.close();
+  }
+  else {
+    Output ("PROF Open Log Err");
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * PROF_Cycle() - Close the current cycle and start a new one
+ * ======================================================================================================================
+ */
+void PROF_Cycle() {
+  if (!cf_profile) {
+    return;
+  }
+
+  // First call after boot only starts the cycle
+  if (prof_us[PROF_SLEEP]) {
+    prof_mas = 0.0;
+    for (int p=0; p<PROF_PHASES; p++) {
+      prof_ms[p] = prof_us[p] / 1000;
+      prof_mas += prof_ms[p] * prof_ma[p] / 1000.0;
+    }
+    prof_valid = true;
+
+    sprintf (msgbuf, "PROF:%lus %d.%01dmAs",
+      (prof_ms[PROF_WAKE]+prof_ms[PROF_TAKE]+prof_ms[PROF_LOG]+prof_ms[PROF_SEND]+
+       prof_ms[PROF_N2S]+prof_ms[PROF_DHCP]+prof_ms[PROF_QUIET]) / 1000,
+      (int)prof_mas, (int)(prof_mas*10)%10);
+    Output (msgbuf);
+
+    PROF_Log();
+  }
+
+  for (int p=0; p<PROF_PHASES; p++) {
+    prof_us[p] = 0;
+  }
+}
@@ -0,0 +1,126 @@
+/*
+ * ======================================================================================================================
+ *  PWR.h - Battery Power Policy
+ *
+ *  Keeps a smoothed battery voltage and its slope, and steps the station through power tiers as the battery drops.
+ *  Each lower tier samples the gauge less, observes less often, and moves Ethernet from every observation to batch
+ *  sessions and finally off. Each tier also caps the energy one N2S drain may use. Observations are always logged
+ *  to SD. The tier is reported in hth bits 16-17.
+ *
+ *  Tiers are entered as soon as the smoothed voltage is below the tier voltage, or one tier early when the slope
+ *  says it will be there within PWR_LOOKAHEAD hours. Recovery is one tier at a time and needs PWR_HYSTERESIS volts
+ *  above the tier voltage.
+ * ======================================================================================================================
+ */
+#define PWR_NORMAL          0
+#define PWR_CONSERVE        1
+#define PWR_BATCH           2
+#define PWR_LOGONLY         3
+#define PWR_TIERS           4
+
+#define PWR_SEND_NOW        0       // Send each observation as it is taken
+#define PWR_SEND_BATCH      1       // Save observations to N2S, send them in batch sessions
+#define PWR_SEND_NONE       2       // Save observations to N2S, no Ethernet
+
+#define PWR_ALPHA           0.25    // Smoothing of voltage and slope per observation
+#define PWR_LOOKAHEAD       12.0    // Hours, slope projection
+#define PWR_HYSTERESIS      0.10    // Volts above the tier voltage before stepping back up
+
+typedef struct {
+  const char     *name;
+  float          volts;             // Enter tier when smoothed voltage is below this
+  uint32_t       gauge_period;      // Seconds between gauge sub-samples, 0 = off
+  unsigned int   gauge_samples;     // Sub-samples wanted for the median, burst read if we don't have them
+  uint32_t       obs_period;        // Seconds between observations
+  uint32_t       net_period;        // Seconds between DHCP and N2S sessions, 0 = off
+  byte           send;
+  float          n2s_mas;           // Energy a N2S drain may use, mA*s. 91200 is 10m sending
+} PWR_TIER;
+
+// Voltages are set from CONFIG.TXT by PWR_Initialize()
+PWR_TIER pwr_tiers[PWR_TIERS] = {
+  {"NORMAL",   0.0,  15, 60,  900,   900, PWR_SEND_NOW,   91200},
+  {"CONSERVE", 0.0,  60, 30, 1800,  1800, PWR_SEND_NOW,   27360},
+  {"BATCH",    0.0,   0, 12, 3600, 21600, PWR_SEND_BATCH, 45600},
+  {"LOGONLY",  0.0,   0, 12, 3600,     0, PWR_SEND_NONE,  0}
+};
+
+int pwr_tier = PWR_NORMAL;
+float pwr_vbs = 0.0;                // Smoothed battery voltage
+float pwr_slope = 0.0;              // Smoothed volts per hour
+uint32_t pwr_last = 0;              // Unix time of last update, 0 = no readings yet
+
+/*
+ * ======================================================================================================================
+ * PWR_Initialize() - Set tier voltages from the config
+ * ======================================================================================================================
+ */
+void PWR_Initialize() {
+  pwr_tiers[PWR_CONSERVE].volts = cf_pwr_conserve;
+  pwr_tiers[PWR_BATCH].volts    = cf_pwr_batch;
+  pwr_tiers[PWR_LOGONLY].volts  = cf_pwr_logonly;
+}
+
+/*
+ * ======================================================================================================================
+ * PWR_Log() - Log tier change to SD and console
+ *
+ * {"at":"2022-02-13T17:30:00","pwr":2,"vbs":3.54,"vsl":-0.012}
+ * ======================================================================================================================
+ */
+void PWR_Log(int from) {
+  sprintf (msgbuf, "PWR:%s->%s", pwr_tiers[from].name, pwr_tiers[pwr_tier].name);
+  Output (msgbuf);
+
+  sprintf (msgbuf, "{\"at\":\"%d-%02d-%02dT%02d:%02d:%02d\",\"pwr\":%d,\"vbs\":%d.%02d,\"vsl\":%.3f}",
+    now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second(),
+    pwr_tier, (int)pwr_vbs, (int)(pwr_vbs*100)%100, pwr_slope);
+  SD_LogText(msgbuf);
+}
+
+/*
+ * ======================================================================================================================
+ * PWR_Update() - Add a battery reading taken at unix time t, returns true if the tier changed
+ * ======================================================================================================================
+ */
+bool PWR_Update(float v, uint32_t t) {
+  int target = PWR_NORMAL;
+  int from = pwr_tier;
+
+  if (pwr_last == 0) {
+    pwr_vbs = v;
+    pwr_slope = 0.0;
+  }
+  else if (t > pwr_last) {
+    float prev = pwr_vbs;
+    pwr_vbs += PWR_ALPHA * (v - pwr_vbs);
+    pwr_slope += PWR_ALPHA * (((pwr_vbs - prev) * 3600.0 / (t - pwr_last)) - pwr_slope);
+  }
+  pwr_last = t;
+
+  for (int i=1; i<PWR_TIERS; i++) {
+    if (pwr_vbs < pwr_tiers[i].volts) {
+      target = i;
+    }
+  }
+
+  // Falling fast enough to reach the next tier soon, go there now
+  if ((target < PWR_LOGONLY) && (pwr_slope < 0.0) &&
+      ((pwr_vbs + (pwr_slope * PWR_LOOKAHEAD)) < pwr_tiers[target+1].volts)) {
+    target++;
+  }
+
+  if (target > pwr_tier) {
+    pwr_tier = target;
+  }
+  else if ((target < pwr_tier) && (pwr_vbs > (pwr_tiers[pwr_tier].volts + PWR_HYSTERESIS))) {
+    pwr_tier--;
+  }
+
+  if (pwr_tier != from) {
+    SystemStatusBits = (SystemStatusBits & ~SSB_PWR_TIER) | ((unsigned int) pwr_tier << 16);
+    PWR_Log(from);
+    return (true);
+  }
+  return (false);
+}
@@ -0,0 +1,410 @@
+/*
+ * ======================================================================================================================
+ *  SCH.h - Task Scheduler
+ *
+ *  Small run-to-completion scheduler. Each task has its own cadence. Periodic tasks are aligned to wall clock
+ *  boundaries (unix time % period == offset) so observations stay on the 0, 15, 30 and 45 minute marks. After all
+ *  due tasks have run we sleep until the earliest deadline. Tasks are run in table order when due at the same time.
+ *
+ *  Time is read through SCH_Clock and sleeping is done through SCH_Sleep. Both default to the RTC. Pointing them
+ *  at a virtual clock lets the scheduling decisions be exercised on a host build without hardware, as
+ *  Tools/host/sch_test.cpp does.
+ * ======================================================================================================================
+ */
+#define SCH_MAX_TASKS       10
+
+#define SCH_NET             0x1     // Task needs the Ethernet PHY powered up with link
+#define SCH_QUIET           0x2     // Task runs without waking the OLED or logging
+#define SCH_OFF             0x4     // Task is turned off
+
+#define SCH_OBS_PERIOD      900     // 15m observations
+#define SCH_I2C_PERIOD      300     // Sensor hot-plug check
+#define SCH_N2S_OFFSET      60      // N2S drain runs after the observation has been sent
+#define SCH_N2S_MARGIN      30      // Seconds the N2S drain leaves before the next observation
+#define SCH_NTP_PERIOD      86400   // Keep the RTC disciplined once a day
+#define SCH_NTP_OFFSET      450     // Between observations
+
+typedef void (*SCH_FUNC)();
+
+typedef struct {
+  const char   *name;
+  SCH_FUNC     func;
+  uint32_t     period;              // Seconds, 0 = one-shot
+  uint32_t     offset;              // Seconds past the period boundary
+  uint32_t     next;                // Unix time of next run
+  byte         flags;
+  bool         inuse;
+} SCH_TASK;
+
+SCH_TASK sch_tasks[SCH_MAX_TASKS];
+int sch_gauge = -1;                 // Task ids the power policy adjusts
+int sch_dhcp = -1;
+int sch_obs = -1;
+int sch_n2s = -1;
+int sch_ntp = -1;
+bool sch_eth_awake = true;          // Ethernet PHY is powered up after Ethernet_Initialize()
+bool sch_oled_awake = true;
+
+/*
+ * ======================================================================================================================
+ * SCH_RTC_Clock() - Default clock, unix time from the RTC
+ * ======================================================================================================================
+ */
+uint32_t SCH_RTC_Clock() {
+  return (rtc_epoch());
+}
+
+void SCH_RTC_Sleep(uint32_t wake_time);  // Prototype this function to aviod compile function unknown issue.
+
+uint32_t (*SCH_Clock)() = SCH_RTC_Clock;
+void (*SCH_Sleep)(uint32_t) = SCH_RTC_Sleep;
+
+/*
+ * ======================================================================================================================
+ * SCH_NextBoundary() - First time after t where (time % period) == offset
+ * ======================================================================================================================
+ */
+uint32_t SCH_NextBoundary(uint32_t t, uint32_t period, uint32_t offset) {
+  uint32_t n = t - (t % period) + offset;
+
+  while (n <= t) {
+    n += period;
+  }
+  return (n);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_Add() - Add a periodic task, returns task id or -1 if the table is full
+ * ======================================================================================================================
+ */
+int SCH_Add(const char *name, SCH_FUNC func, uint32_t period, uint32_t offset, byte flags) {
+  for (int t=0; t<SCH_MAX_TASKS; t++) {
+    if (!sch_tasks[t].inuse) {
+      sch_tasks[t].name   = name;
+      sch_tasks[t].func   = func;
+      sch_tasks[t].period = period;
+      sch_tasks[t].offset = offset % period;
+      sch_tasks[t].next   = SCH_NextBoundary(SCH_Clock(), period, sch_tasks[t].offset);
+      sch_tasks[t].flags  = flags;
+      sch_tasks[t].inuse  = true;
+      return (t);
+    }
+  }
+  sprintf (msgbuf, "SCH:FULL %s", name);
+  Output (msgbuf);
+  return (-1);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_Once() - Add a one-shot task to run at unix time at, returns task id or -1 if the table is full
+ * ======================================================================================================================
+ */
+int SCH_Once(const char *name, SCH_FUNC func, uint32_t at, byte flags) {
+  for (int t=0; t<SCH_MAX_TASKS; t++) {
+    if (!sch_tasks[t].inuse) {
+      sch_tasks[t].name   = name;
+      sch_tasks[t].func   = func;
+      sch_tasks[t].period = 0;
+      sch_tasks[t].offset = 0;
+      sch_tasks[t].next   = at;
+      sch_tasks[t].flags  = flags;
+      sch_tasks[t].inuse  = true;
+      return (t);
+    }
+  }
+  sprintf (msgbuf, "SCH:FULL %s", name);
+  Output (msgbuf);
+  return (-1);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_Reschedule() - Change a periodic task's period and flags, period 0 turns the task off
+ * ======================================================================================================================
+ */
+void SCH_Reschedule(int t, uint32_t period, byte flags) {
+  if ((t < 0) || (t >= SCH_MAX_TASKS) || !sch_tasks[t].inuse) {
+    return;
+  }
+
+  if (period == 0) {
+    sch_tasks[t].flags = flags | SCH_OFF;
+  }
+  else {
+    if ((sch_tasks[t].period != period) || (sch_tasks[t].flags & SCH_OFF)) {
+      sch_tasks[t].next = SCH_NextBoundary(SCH_Clock(), period, sch_tasks[t].offset);
+    }
+    sch_tasks[t].period = period;
+    sch_tasks[t].flags  = flags;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_Cancel() - Remove a task
+ * ======================================================================================================================
+ */
+void SCH_Cancel(int t) {
+  if ((t >= 0) && (t < SCH_MAX_TASKS)) {
+    sch_tasks[t].inuse = false;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_NextDeadline() - Earliest next run time of all tasks, 0 if no tasks
+ * ======================================================================================================================
+ */
+uint32_t SCH_NextDeadline() {
+  uint32_t deadline = 0;
+
+  for (int t=0; t<SCH_MAX_TASKS; t++) {
+    if (sch_tasks[t].inuse && !(sch_tasks[t].flags & SCH_OFF) && 
+        ((deadline == 0) || (sch_tasks[t].next < deadline))) {
+      deadline = sch_tasks[t].next;
+    }
+  }
+  return (deadline);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_Wake() - Bring up what a task needs before it runs
+ * ======================================================================================================================
+ */
+void SCH_Wake(byte flags) {
+  PROF_Begin(PROF_WAKE);
+  if (!(flags & SCH_QUIET) && !sch_oled_awake) {
+    OLED_wakeDisplay();   // May need to toggle the Display reset pin.
+    OLED_ClearDisplayBuffer();
+    Output("Wakeup");
+    sch_oled_awake = true;
+  }
+
+  if ((flags & SCH_NET) && cf_ethernet_enable && !sch_eth_awake) {
+    Ethernet.phyMode(ALL_AUTONEG);  // Restores the WIZ5500 PHY to normal operation 132mA when 100M & Transmitting
+    Output("ETH:Awake");
+    Ethernet_WaitLink();
+    sch_eth_awake = true;
+  }
+  PROF_End(PROF_WAKE);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_RunDue() - Run every task whose deadline has passed, returns number of tasks run
+ * ======================================================================================================================
+ */
+int SCH_RunDue() {
+  int ran = 0;
+  bool again = true;
+
+  // Tasks take time to run, keep going until a full pass finds nothing due
+  while (again) {
+    again = false;
+    for (int t=0; t<SCH_MAX_TASKS; t++) {
+      if (sch_tasks[t].inuse && !(sch_tasks[t].flags & SCH_OFF) && (sch_tasks[t].next <= SCH_Clock())) {
+        SCH_Wake(sch_tasks[t].flags);
+        if (!(sch_tasks[t].flags & SCH_QUIET)) {
+          sprintf (msgbuf, "SCH:%s", sch_tasks[t].name);
+          Output (msgbuf);
+        }
+
+        if (sch_tasks[t].flags & SCH_QUIET) {
+          PROF_Begin(PROF_QUIET);
+          sch_tasks[t].func();
+          PROF_End(PROF_QUIET);
+        }
+        else {
+          sch_tasks[t].func();
+        }
+        ran++;
+        again = true;
+
+        if (sch_tasks[t].period) {
+          // Missed runs are skipped, not queued
+          sch_tasks[t].next = SCH_NextBoundary(SCH_Clock(), sch_tasks[t].period, sch_tasks[t].offset);
+        }
+        else {
+          sch_tasks[t].inuse = false;
+        }
+      }
+    }
+  }
+  return (ran);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_RTC_Sleep() - Power down peripherals and sleep until wake_time
+ * ======================================================================================================================
+ */
+void SCH_RTC_Sleep(uint32_t wake_time) {
+  if (sch_oled_awake) {
+    Output("Going to Sleep");
+  }
+
+  if (cf_ethernet_enable && sch_eth_awake) {
+    if (cf_mqtt_broker[0]) {
+      MQTT_Disconnect();  // The connection does not outlive the PHY, the broker keeps the session
+    }
+    Ethernet.phyMode(POWER_DOWN);  // Puts the WIZ5500 PHY into power-down mode 13mA
+    Output("ETH:Sleeping");
+    sch_eth_awake = false;
+  }
+
+  // Log and N2S files stay open, make sure what we wrote is on the card. With sd_sync=N records wait in RAM, which
+  // standby keeps, until there are N of them
+  if (!cf_sd_sync) {
+    SD_Sync();
+  }
+
+  if (SerialConsoleEnabled) {
+    Serial.flush();  // Let the console drain before USB goes to standby
+  }
+
+  if (sch_oled_awake) {
+    OLED_sleepDisplay();
+    sch_oled_awake = false;
+  }
+
+  uint32_t slept = rtc_epoch();
+  rtc_sleep_until(wake_time); // DS3231 alarm wake, internal RTC fallback
+  PROF_Sleep(rtc_epoch() - slept);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_Run() - Run due tasks then sleep until the next deadline
+ * ======================================================================================================================
+ */
+void SCH_Run() {
+  SCH_RunDue();
+
+  uint32_t deadline = SCH_NextDeadline();
+  if (deadline > SCH_Clock()) {
+    SCH_Sleep(deadline);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_Power() - Set task cadences from the current power tier
+ * ======================================================================================================================
+ */
+void SCH_Power() {
+  PWR_TIER *p = &pwr_tiers[pwr_tier];
+  uint32_t net_period = (cf_ethernet_enable) ? p->net_period : 0;
+
+  SCH_Reschedule(sch_gauge, p->gauge_period, SCH_QUIET);
+  distance_samples = p->gauge_samples;
+
+  SCH_Reschedule(sch_obs, p->obs_period, (p->send == PWR_SEND_NOW) ? SCH_NET : 0);
+  SCH_Reschedule(sch_dhcp, net_period, SCH_NET);
+  SCH_Reschedule(sch_n2s, net_period, SCH_NET);
+  SCH_Reschedule(sch_ntp, (net_period) ? SCH_NTP_PERIOD : 0, SCH_NET);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_OBS() - Observation task
+ * ======================================================================================================================
+ */
+void SCH_OBS() {
+  PROF_Cycle();  // Close the profile of the cycle that just ended
+
+  Time_of_obs = rtc_epoch();
+
+  // Step power tiers on the battery trend before the observation so hth carries the new tier
+  if (PWR_Update(vbat_get(), Time_of_obs)) {
+    SCH_Power();
+  }
+
+  if ((now.year() >= TM_VALID_YEAR_START) && (now.year() <= TM_VALID_YEAR_END)) {
+    OBS_Do();
+  }
+  else {
+    Output ("OBS_Do() NotRun-Bad TM");
+  }
+
+  // Shutoff System Status Bits related to initialization after we have logged first observation
+  JPO_ClearBits();
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_DHCP() - DHCP lease renewal task
+ * ======================================================================================================================
+ */
+void SCH_DHCP() {
+  PROF_Begin(PROF_DHCP);
+  Ethernet_Renew_DHCP();
+  PROF_End(PROF_DHCP);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_N2S_Budget() - Milliseconds the N2S drain of left records may run. The least of the time to the next
+ *                    observation, the power tier's drain energy at the N2S current and the time the backlog
+ *                    takes at the smoothed send time and gap. A short backlog does not keep the PHY up for the
+ *                    whole window.
+ * ======================================================================================================================
+ */
+uint32_t SCH_N2S_Budget(uint32_t left) {
+  uint32_t t = SCH_Clock();
+  uint32_t next = sch_tasks[sch_obs].next;
+  uint32_t time_ms = (next > (t + SCH_N2S_MARGIN)) ? (next - t - SCH_N2S_MARGIN) * 1000 : 0;
+  uint32_t energy_ms = pwr_tiers[pwr_tier].n2s_mas * 1000.0 / prof_ma[PROF_N2S];
+  uint32_t budget_ms = (time_ms < energy_ms) ? time_ms : energy_ms;
+  uint64_t backlog_ms;
+
+  // No send time yet before the first drain, it is found by sending. One record more for sends slower than smoothed.
+  if (obs_n2s_rtt) {
+    backlog_ms = (uint64_t) (left + 1) * (obs_n2s_rtt + OBS_N2S_Gap());
+    if (backlog_ms < budget_ms) {
+      budget_ms = backlog_ms;
+    }
+  }
+  return (budget_ms);
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_N2S() - Need to Send drain task
+ * ======================================================================================================================
+ */
+void SCH_N2S() {
+  if (ip_valid && (SystemStatusBits & SSB_N2S)) {
+    PROF_Begin(PROF_N2S);
+    OBS_N2S_Publish();
+    PROF_End(PROF_N2S);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * SCH_Initialize() - Register tasks. Order matters, tasks due at the same time run in table order.
+ * ======================================================================================================================
+ */
+void SCH_Initialize() {
+  for (int t=0; t<SCH_MAX_TASKS; t++) {
+    sch_tasks[t].inuse = false;
+  }
+
+  sch_gauge = SCH_Add("GAUGE", Distance_Sample, DISTANCE_SAMPLE_PERIOD, 0, SCH_QUIET);
+  SCH_Add("I2C",   I2C_Check_Sensors, SCH_I2C_PERIOD, 0, SCH_QUIET);
+  if (cf_ethernet_enable) {
+    sch_dhcp = SCH_Add("DHCP", SCH_DHCP, SCH_OBS_PERIOD, 0, SCH_NET);
+  }
+  sch_obs = SCH_Add("OBS", SCH_OBS, SCH_OBS_PERIOD, 0, SCH_NET);
+  if (cf_ethernet_enable) {
+    sch_n2s = SCH_Add("N2S", SCH_N2S, SCH_OBS_PERIOD, SCH_N2S_OFFSET, SCH_NET);
+    sch_ntp = SCH_Add("NTP", Ethernet_UpdateTime, SCH_NTP_PERIOD, SCH_NTP_OFFSET, SCH_NET);
+  }
+  SCH_Power();
+
+  // First observation right away, then on the 15m boundaries
+  SCH_Once("OBS1", SCH_OBS, SCH_Clock(), SCH_NET);
+}
@@ -11,18 +11,200 @@
 #define CF_NAME           "CONFIG.TXT"
 #define KEY_MAX_LENGTH    30                // Config File Key Length
 #define VALUE_MAX_LENGTH  30                // Config File Value Length
-#define LINE_MAX_LENGTH   VALUE_MAX_LENGTH+KEY_MAX_LENGTH+3   // =, CR, LF 
+#define LINE_MAX_LENGTH   (VALUE_MAX_LENGTH+KEY_MAX_LENGTH+3) // =, CR, LF 
 
 // SdFat SD;                                // File system object.
 // SD;                                      // File system object defined by the SD.h include file.
 File SD_fp;
 char SD_obsdir[] = "/OBS";                  // Observations stored in this directory. Created at power on if not exist
 bool SD_exists = false;                     // Set to true if SD card found at boot
-char SD_n2s_file[] = "N2SOBS.TXT";          // Need To Send Observation file
-uint32_t SD_n2s_max_filesz = 512 * 60 * 24; // Keep a little over 1 day. When it fills, it is deleted and we start over.
+char SD_n2s_file[] = "N2SOBS.DAT";          // Need To Send Observation file
+char SD_n2s_index[] = "N2SOBS.IDX";         // Offset of each good frame in the N2S file, made as it is drained
+char SD_seq_file[] = "OBSSEQ.DAT";          // End of the last block of sequence numbers reserved, see NVM.h
+uint32_t SD_n2s_max_filesz = 512 * 60 * 24; // Months of records at 15m. When it fills, it is deleted and we start over.
+
+// The daily log and the N2S file hold binary records, [length][schema][data]. Schema 0 is a line of text, the
+// observation schema is in OBS.h. Text is only rendered from them to send and to export.
+#define SD_REC_LEN        0                 // Offset of the record length, the length includes this byte
+#define SD_REC_SCHEMA     1                 // Offset of the schema id
+#define SD_REC_HDR        2                 // Bytes before the data
+#define SD_REC_MAX        255
+#define SD_SCHEMA_TEXT    0
+
+// Each record is framed on the card as [SD_REC_SYNC][record][CRC-32 of the record]. A record torn by a power loss
+// fails its CRC, readers step past it to the next sync byte that starts a good frame, so only that record is lost.
+#define SD_REC_SYNC       0xA5
+#define SD_REC_FRAME      5                 // Bytes a frame adds to its record
+
+// N2S index entries are the uint32 file offset of a frame, with this bit set once the record is sent or skipped
+#define SD_N2S_SENT       0x80000000UL
+
+void OBS_Export(const char *path);          // Prototype this function to aviod compile function unknown issue.
+
+// Daily files are kept in /OBS/YYYY/MM so no directory grows past a month of files. The current month's
+// directory is kept open, files are opened in it without walking the path.
+File SD_monthdir;                           // Open month directory
+char SD_monthdir_name[16] = "";             // /OBS/YYYY/MM
+#define SD_LAYOUT_MARKER  "LAYOUT.YM"       // In /OBS once flat daily files have been moved to YYYY/MM
+
+// Files kept open across observations. Opening walks the path and closing syncs the directory entry and FAT,
+// so we only do that at midnight rollover. SD_Sync() is called before sleep.
+File SD_logfp;                              // Today's observation log
+char SD_logfp_name[32] = "";                // Path of the open log, used to detect rollover
+bool SD_log_keyframe = false;               // Set when the log is opened, the next observation must be a full record
+File SD_n2sfp;                              // Need To Send file, opened for append
+bool SD_dirty = false;                      // Data written since last SD_Sync()
+
+// Records are held in RAM and only written when they complete a 512 byte block of the file, so the card never
+// has to read, modify and write a partial block. How often buffered records are forced out is cf_sd_sync.
+#define SD_BLOCK_SIZE 512
+
+typedef struct {
+  File          *fp;
+  uint8_t       buf[SD_BLOCK_SIZE];
+  uint16_t      len;                        // Bytes buffered
+  uint16_t      records;                    // Records buffered since the last flush
+} SD_APPEND_BUF;
+
+SD_APPEND_BUF SD_logbuf = {&SD_logfp};
+SD_APPEND_BUF SD_n2sbuf = {&SD_n2sfp};
+
+uint32_t SD_reads = 0;                      // Block counts at the last SD_Stats()
+uint32_t SD_writes = 0;
+uint32_t SD_hits = 0;                       // Volume cache counts at the last SD_Stats()
+uint32_t SD_misses = 0;
+uint32_t SD_allocs = 0;                     // Cluster allocation counts at the last SD_Stats()
+uint32_t SD_alloc_us = 0;
+uint32_t SD_alloc_reads = 0;
 
-// Need 2 Send File Pointer
-int n2sfp = 0;
+/* 
+ *=======================================================================================================================
+ * SD_ObsDir() - Make /OBS/YYYY/MM the open month directory, creating it if needed. Returns false on error
+ *=======================================================================================================================
+ */
+bool SD_ObsDir(int year, int month) {
+  char dir[16];
+
+  sprintf (dir, "%s/%4d/%02d", SD_obsdir, year, month);
+  if (SD_monthdir && !strcmp(dir, SD_monthdir_name)) {
+    return (true);
+  }
+
+  if (SD_monthdir) {
+    SD_monthdir.close();
+  }
+  SD_monthdir_name[0] = 0;
+
+  if (!SD.exists(dir) && !SD.mkdir(dir)) {
+    sprintf (msgbuf, "SD:MKDIR %s ERR", dir);
+    Output (msgbuf);
+    return (false);
+  }
+  SD_monthdir = SD.open(dir);
+  if (!SD_monthdir) {
+    return (false);
+  }
+  strcpy (SD_monthdir_name, dir);
+  return (true);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_Migrate() - Move daily files from the old flat /OBS layout into /OBS/YYYY/MM, runs once per card
+ *=======================================================================================================================
+ */
+void SD_Migrate() {
+  char marker[24];
+  char name[13];
+  File dir, fp;
+  int moved = 0;
+  int failed = 0;
+
+  sprintf (marker, "%s/%s", SD_obsdir, SD_LAYOUT_MARKER);
+  if (SD.exists(marker)) {
+    return;
+  }
+
+  dir = SD.open(SD_obsdir);
+  while (dir && (fp = dir.openNextFile())) {
+    // Daily files are YYYYMMDD.LOG and YYYYMMDD.PRF, leave anything else
+    strcpy (name, fp.name());
+    bool daily = !fp.isDirectory() && (strlen(name) == 12) && (name[8] == '.');
+    for (int i=0; daily && (i<8); i++) {
+      daily = isdigit(name[i]);
+    }
+
+    if (daily) {
+      int year = (name[0]-'0')*1000 + (name[1]-'0')*100 + (name[2]-'0')*10 + (name[3]-'0');
+      int month = (name[4]-'0')*10 + (name[5]-'0');
+      if (SD_ObsDir(year, month) && SD.rename(fp, SD_monthdir, name)) {
+        moved++;
+      }
+      else {
+        failed++;
+      }
+    }
+    fp.close();
+  }
+  if (dir) {
+    dir.close();
+  }
+
+  sprintf (msgbuf, "SD:MIGRATE %d %d", moved, failed);
+  Output (msgbuf);
+
+  // Try again next boot if anything was left behind
+  if (!failed) {
+    fp = SD.open(marker, FILE_WRITE);
+    if (fp) {
+      fp.close();
+    }
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_SeqLoad() - End of the last block of sequence numbers reserved, from the card. 0 if there is none
+ *=======================================================================================================================
+ */
+uint32_t SD_SeqLoad() {
+  uint32_t v[2] = {0, 0};             // Block end and its CRC
+  File fp;
+
+  if (SD_exists) {
+    fp = SD.open(SD_seq_file, FILE_READ);
+  }
+  if (fp) {
+    if ((fp.read(v, sizeof(v)) != sizeof(v)) || (crc32(0, &v[0], 4) != v[1])) {
+      Output ("SD:SEQ BAD");
+      v[0] = 0;
+    }
+    fp.close();
+  }
+  return (v[0]);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_SeqSave() - Write the end of the block of sequence numbers just reserved to the card, in place
+ *=======================================================================================================================
+ */
+bool SD_SeqSave(uint32_t limit) {
+  uint32_t v[2] = {limit, crc32(0, &limit, 4)};
+  File fp;
+  bool ok;
+
+  if (!SD_exists) {
+    return (false);
+  }
+  fp = SD.open(SD_seq_file, O_WRITE | O_CREAT);
+  if (!fp) {
+    return (false);
+  }
+  ok = (fp.write((uint8_t *) v, sizeof(v)) == sizeof(v));
+  fp.close();
+  return (ok);
+}
 
 /* 
  *=======================================================================================================================
@@ -33,7 +215,9 @@ void SD_initialize() {
   if (!SD.begin(SD_ChipSelect)) {
     Output ("SD:NF");
     SystemStatusBits |= SSB_SD;
-    delay (5000);
+    if (!FastBoot) {
+      delay (5000);
+    }
   }
   else {
     SD_exists = true;
@@ -54,46 +238,261 @@ void SD_initialize() {
       Output ("SD:OBS DIR Exists");
       SD_exists = true;
     }
+    if (SD_exists) {
+      SD_Migrate();
+
+      // A backlog left from before a reset or reflash, the N2S task drains it
+      if (SD.exists(SD_n2s_file)) {
+        File fp = SD.open(SD_n2s_file, FILE_READ);
+        if (fp && (fp.size() > SD_REC_FRAME)) {
+          SystemStatusBits |= SSB_N2S;
+          Output ("SD:N2S Exists");
+        }
+        if (fp) {
+          fp.close();
+        }
+      }
+    }
   }
 }
 
 /* 
  *=======================================================================================================================
- * SD_LogObservation()
+ * SD_AppendFlush() - Write what is buffered, returns false on a write error
  *=======================================================================================================================
  */
-void SD_LogObservation(char *observations) {
-  char SD_logfile[24];
-  File fp;
+bool SD_AppendFlush(SD_APPEND_BUF *ab) {
+  bool ok = true;
 
-  if (!SD_exists) {
-    return;
+  if (ab->len && *ab->fp) {
+    ok = (ab->fp->write(ab->buf, ab->len) == ab->len);
   }
+  ab->len = 0;
+  return (ok);
+}
 
-  if (!RTC_valid) {
-    return;
+/* 
+ *=======================================================================================================================
+ * SD_AppendBytes() - Buffer bytes, write out each block as it fills. Returns false on a write error
+ *=======================================================================================================================
+ */
+bool SD_AppendBytes(SD_APPEND_BUF *ab, const uint8_t *p, int n) {
+  uint16_t room = SD_BLOCK_SIZE - (ab->fp->size() % SD_BLOCK_SIZE);  // Bytes to the next block boundary of the file
+
+  while (n--) {
+    ab->buf[ab->len++] = *p++;
+
+    if (ab->len == room) {
+      if (!SD_AppendFlush(ab)) {
+        return (false);
+      }
+      room = SD_BLOCK_SIZE;
+    }
+  }
+  return (true);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_Append() - Buffer a record in its frame. Returns false on a write error
+ *=======================================================================================================================
+ */
+bool SD_Append(SD_APPEND_BUF *ab, const uint8_t *record) {
+  uint8_t sync = SD_REC_SYNC;
+  uint32_t crc = crc32(0, record, record[SD_REC_LEN]);
+
+  if (!SD_AppendBytes(ab, &sync, 1) ||
+      !SD_AppendBytes(ab, record, record[SD_REC_LEN]) ||
+      !SD_AppendBytes(ab, (const uint8_t *) &crc, 4)) {
+    return (false);
+  }
+
+  ab->records++;
+  if (cf_sd_sync && (ab->records >= cf_sd_sync)) {
+    ab->records = 0;
+    if (!SD_AppendFlush(ab)) {
+      return (false);
+    }
+    ab->fp->flush();
+  }
+  else {
+    SD_dirty = true;
+  }
+  return (true);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_ReadRecord() - Read the next good record into rec, returns false at the end of the file. The bytes of torn or
+ *                   corrupt frames stepped over are added to skipped
+ *=======================================================================================================================
+ */
+bool SD_ReadRecord(File &fp, uint8_t *rec, uint32_t *skipped) {
+  uint32_t crc;
+
+  while (fp.available()) {
+    uint32_t start = fp.position();
+
+    if (fp.read() == SD_REC_SYNC) {
+      int len = fp.read();
+
+      if ((len >= SD_REC_HDR) && (fp.read(&rec[1], len - 1) == (len - 1)) && (fp.read(&crc, 4) == 4)) {
+        rec[SD_REC_LEN] = len;
+        if (crc32(0, rec, len) == crc) {
+          return (true);
+        }
+      }
+      fp.seek(start + 1);  // Look for the next frame from the byte after this sync
+    }
+    (*skipped)++;
+  }
+  return (false);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_Sync() - Write buffered records, directory entries and FAT of the open files to the card
+ *=======================================================================================================================
+ */
+void SD_Sync() {
+  if (SD_dirty) {
+    if (SD_logfp) {
+      SD_AppendFlush(&SD_logbuf);
+      SD_logfp.flush();
+    }
+    if (SD_n2sfp) {
+      SD_AppendFlush(&SD_n2sbuf);
+      SD_n2sfp.flush();
+    }
+    SD_logbuf.records = 0;
+    SD_n2sbuf.records = 0;
+    SD_dirty = false;
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_Stats() - Output SD blocks read and written, volume cache hits and misses, and cluster allocations with their
+ *              average FAT search time and FAT blocks read, since the last call. The longest search is since boot.
+ *=======================================================================================================================
+ */
+void SD_Stats() {
+  if (SD_exists) {
+    sprintf (msgbuf, "SD:R%lu W%lu H%lu M%lu", SD.blockReads() - SD_reads, SD.blockWrites() - SD_writes,
+      SD.cacheHits() - SD_hits, SD.cacheMisses() - SD_misses);
+    Output (msgbuf);
+    SD_reads = SD.blockReads();
+    SD_writes = SD.blockWrites();
+    SD_hits = SD.cacheHits();
+    SD_misses = SD.cacheMisses();
+
+    uint32_t allocs = SD.allocCount() - SD_allocs;
+    if (allocs) {
+      sprintf (msgbuf, "SD:A%lu %lu/%luus F%lu", allocs, (SD.allocMicros() - SD_alloc_us) / allocs,
+        SD.allocMaxMicros(), SD.allocReads() - SD_alloc_reads);
+      Output (msgbuf);
+    }
+    SD_allocs = SD.allocCount();
+    SD_alloc_us = SD.allocMicros();
+    SD_alloc_reads = SD.allocReads();
+  }
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_N2S_Close() - Close the Need To Send file, needed before it is removed
+ *=======================================================================================================================
+ */
+void SD_N2S_Close() {
+  if (SD_n2sfp) {
+    SD_AppendFlush(&SD_n2sbuf);
+    SD_n2sfp.close();
+  }
+  SD_n2sbuf.len = 0;
+  SD_n2sbuf.records = 0;
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_LogOpen() - Make sure today's log is open, closing yesterday's at rollover. Returns false if it can't be
+ *=======================================================================================================================
+ */
+bool SD_LogOpen() {
+  char SD_logfile[32];
+  char name[13];
+
+  if (!SD_exists || !RTC_valid) {
+    return (false);
   }
 
   // Note: "now" is global and is set when ever timestamp() is called. Value last read from RTC.
-  sprintf (SD_logfile, "%s/%4d%02d%02d.log", SD_obsdir, now.year(), now.month(), now.day());
+  sprintf (name, "%4d%02d%02d.obs", now.year(), now.month(), now.day());
+  sprintf (SD_logfile, "%s/%4d/%02d/%s", SD_obsdir, now.year(), now.month(), name);
+
+  // Midnight rollover, close yesterday's log
+  if (SD_logfp && strcmp(SD_logfile, SD_logfp_name)) {
+    SD_AppendFlush(&SD_logbuf);
+    SD_logfp.close();
+    if (cf_log_json) {
+      OBS_Export(SD_logfp_name);
+    }
+  }
 
-  Output (SD_logfile);
-  
-  fp = SD.open(SD_logfile, FILE_WRITE); 
-  if (fp) {
-    fp.println(observations);
-    fp.close();
+  if (!SD_logfp && SD_ObsDir(now.year(), now.month())) {
+    Output (SD_logfile);
+    SD_logfp = SD.open(SD_monthdir, name, FILE_WRITE);
+    strcpy (SD_logfp_name, SD_logfile);
+    SD_log_keyframe = true;
+  }
+  return (SD_logfp);
+}
+
+/* 
+ *=======================================================================================================================
+ * SD_LogRecord() - Append a record to today's log
+ *=======================================================================================================================
+ */
+void SD_LogRecord(const uint8_t *record) {
+  if (!SD_exists || !RTC_valid) {
+    return;
+  }
+
+  if (SD_LogOpen() && SD_Append(&SD_logbuf, record)) {
+    SD_dirty = true;
     SystemStatusBits &= ~SSB_SD;  // Turn Off Bit
     Output ("OBS Logged to SD");
   }
   else {
     SystemStatusBits |= SSB_SD;  // Turn On Bit - Note this will be reported on next observation
     Output ("OBS Open Log Err");
+    if (SD_logfp) {
+      SD_logfp.close();  // Reopen next time
+    }
+    SD_logbuf.len = 0;
+    SD_logbuf.records = 0;
     // At thins point we could set SD_exists to false and/or set a status bit to report it
     // SD_initialize();  // Reports SD NOT Found. Library bug with SD
   }
 }
 
+/* 
+ *=======================================================================================================================
+ * SD_LogText() - Append a line of text to today's log as a text record
+ *=======================================================================================================================
+ */
+void SD_LogText(const char *text) {
+  uint8_t record[SD_REC_MAX];
+  int len = strlen(text);
+
+  if (len > (SD_REC_MAX - SD_REC_HDR)) {
+    len = SD_REC_MAX - SD_REC_HDR;
+  }
+  record[SD_REC_LEN] = SD_REC_HDR + len;
+  record[SD_REC_SCHEMA] = SD_SCHEMA_TEXT;
+  memcpy (&record[SD_REC_HDR], text, len);
+  SD_LogRecord(record);
+}
+
 /* 
  * =======================================================================================================================
  * SD_N2S_Delete()
@@ -101,6 +500,12 @@ void SD_LogObservation(char *observations) {
  */
 bool SD_N2S_Delete() {
   bool result;
+
+  SD_N2S_Close();
+
+  if (SD_exists && SD.exists(SD_n2s_index)) {
+    SD.remove (SD_n2s_index);
+  }
   
   if (SD_exists && SD.exists(SD_n2s_file)) {
     if (SD.remove (SD_n2s_file)) {
@@ -118,36 +523,85 @@ bool SD_N2S_Delete() {
     Output ("N2S->DEL:NF");
     result = true;
   }
-  n2sfp = 0;
   return (result);
 }
 
 /* 
  * =======================================================================================================================
- * SD_NeedToSend_Add()
+ * SD_N2S_Index() - Open the index of the N2S file fp and add the frames after its last entry. The index is made
+ *                  again if its last entry is not a good frame. Returns the number of entries in count
  * =======================================================================================================================
  */
-void SD_NeedToSend_Add(char *observation) {
-  File fp;
+File SD_N2S_Index(File &fp, uint32_t *count) {
+  uint8_t rec[SD_REC_MAX];
+  uint32_t entry;
+  uint32_t skipped = 0;
+  File ix = SD.open(SD_n2s_index, O_READ | O_WRITE | O_CREAT);
+
+  if (!ix) {
+    return (ix);
+  }
+
+  *count = ix.size() / 4;
+  if (*count) {
+    ix.seek((*count - 1) * 4);
+    ix.read(&entry, 4);
+    fp.seek(entry & ~SD_N2S_SENT);
+    if (!SD_ReadRecord(fp, rec, &skipped) || skipped) {
+      Output ("N2S:IDX REMAKE");
+      ix.close();
+      SD.remove (SD_n2s_index);
+      ix = SD.open(SD_n2s_index, O_READ | O_WRITE | O_CREAT);
+      if (!ix) {
+        return (ix);
+      }
+      *count = 0;
+      fp.seek(0);
+    }
+  }
+
+  // fp is after the last frame in the index, torn and corrupt frames are not added
+  ix.seek(ix.size());
+  while (SD_ReadRecord(fp, rec, &skipped)) {
+    entry = fp.position() - rec[SD_REC_LEN] - SD_REC_FRAME;
+    ix.write((uint8_t *) &entry, 4);
+    (*count)++;
+  }
+  if (skipped) {
+    sprintf (msgbuf, "N2S:IDX %lu SKIP %lu", (unsigned long) *count, (unsigned long) skipped);
+    Output (msgbuf);
+  }
+  return (ix);
+}
 
+/* 
+ * =======================================================================================================================
+ * SD_NeedToSend_Add() - Append a record to the N2S file
+ * =======================================================================================================================
+ */
+void SD_NeedToSend_Add(const uint8_t *observation) {
   if (!SD_exists) {
     return;
   }
   
-  fp = SD.open(SD_n2s_file, FILE_WRITE); // Open the file for reading and writing, starting at the end of the file.
-                                         // It will be created if it doesn't already exist.
-  if (fp) {  
-    if (fp.size() > SD_n2s_max_filesz) {
-      fp.close();
+  if (!SD_n2sfp) {
+    SD_n2sfp = SD.open(SD_n2s_file, FILE_WRITE); // Open the file for reading and writing, starting at the end of the file.
+                                                 // It will be created if it doesn't already exist.
+  }
+  if (SD_n2sfp) {  
+    if ((SD_n2sfp.size() + SD_n2sbuf.len) > SD_n2s_max_filesz) {
       Output ("N2S:Full");
       if (SD_N2S_Delete()) {
         // Only call ourself again if we truely deleted the file. Otherwise infinate loop.
         SD_NeedToSend_Add(observation); // Now go and log the data
       }
     }
+    else if (!SD_Append(&SD_n2sbuf, observation)) {
+      SystemStatusBits |= SSB_SD;  // Turn On Bit
+      Output ("N2S:Write Error");
+      SD_N2S_Close();  // Reopen next time
+    }
     else {
-      fp.println(observation); //Print data, followed by a carriage return and newline, to the File
-      fp.close();
       SystemStatusBits &= ~SSB_SD;  // Turn Off Bit
       SystemStatusBits |= SSB_N2S; // Turn on Bit that says there are entries in the N2S File
       Output ("N2S:OBS Added");
@@ -163,225 +617,154 @@ void SD_NeedToSend_Add(char *observation) {
 
 /* 
  * =======================================================================================================================
- * Support functions for Config file
- * 
- *  https://arduinogetstarted.com/tutorials/arduino-read-config-from-sd-card
- *  
- *  myInt_1    = SD_findInt(F("myInt_1"));
- *  myFloat_1  = SD_findFloat(F("myFloat_1"));
- *  myString_1 = SD_findString(F("myString_1"));
- *  
- *  CONFIG.TXT content example
- *  myString_1=Hello
- *  myInt_1=2
- *  myFloat_1=0.74
+ * SD_ConfigLine() - Parse a CONFIG.TXT line into its cf_keys variable, counting unknown and invalid keys. Blank and
+ *                   comment lines are skipped. A truncated line is invalid.
  * =======================================================================================================================
  */
+void SD_ConfigLine(char *line, bool truncated) {
+  char *value, *end;
+  CF_KEY *k = NULL;
 
-int SD_findKey(const __FlashStringHelper * key, char * value) {
-  
-  File configFile = SD.open(CF_NAME);
-
-  if (!configFile) {
-    Serial.print(F("SD Card: error on opening file "));
-    Serial.println(CF_NAME);
-    return(0);
-  }
-
-  char key_string[KEY_MAX_LENGTH];
-  char SD_buffer[KEY_MAX_LENGTH + VALUE_MAX_LENGTH + 1]; // 1 is = character
-  int key_length = 0;
-  int value_length = 0;
-
-  // Flash string to string
-  PGM_P keyPoiter;
-  keyPoiter = reinterpret_cast<PGM_P>(key);
-  byte ch;
-  do {
-    ch = pgm_read_byte(keyPoiter++);
-    if (ch != 0)
-      key_string[key_length++] = ch;
-  } while (ch != 0);
-
-  // check line by line
-  while (configFile.available()) {
-    int buffer_length = configFile.readBytesUntil('\n', SD_buffer, LINE_MAX_LENGTH);
-    if (SD_buffer[buffer_length - 1] == '\r')
-      buffer_length--; // trim the \r
-
-    if (buffer_length > (key_length + 1)) { // 1 is = character
-      if (memcmp(SD_buffer, key_string, key_length) == 0) { // equal
-        if (SD_buffer[key_length] == '=') {
-          value_length = buffer_length - key_length - 1;
-          memcpy(value, SD_buffer + key_length + 1, value_length);
-          break;
-        }
-      }
-    }
+  while ((*line == ' ') || (*line == '\t')) {
+    line++;
   }
-
-  configFile.close();  // close the file
-  return value_length;
-}
-
-int HELPER_ascii2Int(char *ascii, int length) {
-  int sign = 1;
-  int number = 0;
-
-  for (int i = 0; i < length; i++) {
-    char c = *(ascii + i);
-    if (i == 0 && c == '-')
-      sign = -1;
-    else {
-      if (c >= '0' && c <= '9')
-        number = number * 10 + (c - '0');
-    }
+  if ((*line == 0) || (*line == '#')) {
+    return;
   }
 
-  return number * sign;
-}
-
-long HELPER_ascii2Long(char *ascii, int length) {
-  int sign = 1;
-  long number = 0;
+  value = strchr(line, '=');
+  if (value == NULL) {
+    sprintf (msgbuf, "CF:%.20s UNKNOWN", line);
+    Output (msgbuf);
+    cf_unknown++;
+    return;
+  }
+  *value++ = 0;
 
-  for (int i = 0; i < length; i++) {
-    char c = *(ascii + i);
-    if (i == 0 && c == '-')
-      sign = -1;
-    else {
-      if (c >= '0' && c <= '9')
-        number = number * 10 + (c - '0');
+  for (int i=0; i<CF_KEYS; i++) {
+    if (!strcmp(line, cf_keys[i].key)) {
+      k = &cf_keys[i];
+      break;
     }
   }
+  if (k == NULL) {
+    sprintf (msgbuf, "CF:%.20s UNKNOWN", line);
+    Output (msgbuf);
+    cf_unknown++;
+    return;
+  }
 
-  return number * sign;
-}
-
-float HELPER_ascii2Float(char *ascii, int length) {
-  int sign = 1;
-  int decimalPlace = 0;
-  float number  = 0;
-  float decimal = 0;
+  // Trailing blanks are not part of the value
+  end = value + strlen(value);
+  while ((end > value) && ((end[-1] == ' ') || (end[-1] == '\t'))) {
+    *--end = 0;
+  }
 
-  for (int i = 0; i < length; i++) {
-    char c = *(ascii + i);
-    if (i == 0 && c == '-')
-      sign = -1;
+  if (!truncated) {
+    if (k->type == CF_INT) {
+      long l = strtol(value, &end, 10);
+      if ((end != value) && (*end == 0) && (l >= k->min) && (l <= k->max)) {
+        *(int *)k->var = (int) l;
+        return;
+      }
+    }
+    else if (k->type == CF_FLOAT) {
+      float f = strtod(value, &end);
+      if ((end != value) && (*end == 0) && (f >= k->min) && (f <= k->max)) {
+        *(float *)k->var = f;
+        return;
+      }
+    }
     else {
-      if (c == '.')
-        decimalPlace = 1;
-      else if (c >= '0' && c <= '9') {
-        if (!decimalPlace)
-          number = number * 10 + (c - '0');
-        else {
-          decimal += ((float)(c - '0') / pow(10.0, decimalPlace));
-          decimalPlace++;
-        }
+      int len = strlen(value);
+      if ((len >= k->min) && (len <= k->max) && ((cf_arena_used + len + 1) <= CF_ARENA_SIZE)) {
+        *(char **)k->var = strcpy(cf_arena + cf_arena_used, value);
+        cf_arena_used += len + 1;
+        return;
       }
     }
   }
 
-  return (number + decimal) * sign;
-}
-
-String HELPER_ascii2String(char *ascii, int length) {
-  String str;
-  str.reserve(length);
-  str = "";
-
-  for (int i = 0; i < length; i++) {
-    char c = *(ascii + i);
-    str += String(c);
-  }
-  return str;
-}
-
-char* HELPER_ascii2CharStr(char *ascii, int length) {
-  char *str;
-  int i = 0;
-  str = (char *) malloc (length+1);
-  str[0] = 0;
-  for (int i = 0; i < length; i++) {
-    char c = *(ascii + i);
-    str[i] = c;
-    str[i+1] = 0;
-  }
-  return str;
-}
-
-bool SD_available(const __FlashStringHelper * key) {
-  char value_string[VALUE_MAX_LENGTH];
-  int value_length = SD_findKey(key, value_string);
-  return value_length > 0;
-}
-
-int SD_findInt(const __FlashStringHelper * key) {
-  char value_string[VALUE_MAX_LENGTH];
-  int value_length = SD_findKey(key, value_string);
-  return HELPER_ascii2Int(value_string, value_length);
-}
-
-float SD_findFloat(const __FlashStringHelper * key) {
-  char value_string[VALUE_MAX_LENGTH];
-  int value_length = SD_findKey(key, value_string);
-  return HELPER_ascii2Float(value_string, value_length);
-}
-
-String SD_findString(const __FlashStringHelper * key) {
-  char value_string[VALUE_MAX_LENGTH];
-  int value_length = SD_findKey(key, value_string);
-  return HELPER_ascii2String(value_string, value_length);
+  sprintf (msgbuf, "CF:%s INVALID", k->key);
+  Output (msgbuf);
+  cf_invalid++;
 }
 
-char* SD_findCharStr(const __FlashStringHelper * key) {
-  char value_string[VALUE_MAX_LENGTH];
-  int value_length = SD_findKey(key, value_string);
-  return HELPER_ascii2CharStr(value_string, value_length);
-}
-
-long SD_findLong(const __FlashStringHelper * key) {
-  char value_string[VALUE_MAX_LENGTH];
-  int value_length = SD_findKey(key, value_string);
-  return HELPER_ascii2Long(value_string, value_length);
-}
-
-
 /* 
  * =======================================================================================================================
- * SD_ReadConfigFile()
+ * SD_ReadConfigFile() - Read CONFIG.TXT in one pass into the cf_keys table and output the configuration. The result
+ *                       is saved to flash when the file has changed, and loaded from flash when there is no file.
  * =======================================================================================================================
  */
 void SD_ReadConfigFile() {
-  // Ethernet 
-  cf_ethernet_enable  = SD_findInt(F("ethernet_enable"));
-  sprintf(msgbuf, "CF:%s=[%d]", F("ethernet_enable"), cf_ethernet_enable); Output (msgbuf);
-  
-  cf_ethernet_mac     = SD_findCharStr(F("ethernet_mac"));
-  sprintf(msgbuf, "CF:%s=[%s]", F("ethernet_mac"), cf_ethernet_mac); Output (msgbuf);
-    
-  // Web Server
-  cf_webserver      = SD_findCharStr(F("webserver"));
-  sprintf(msgbuf, "CF:%s=[%s]", F("webserver"), cf_webserver); Output (msgbuf);
-
-  // Only port 80 supported, Just use the hard coded port number.
-  // cf_webserver_port = SD_findInt(F("webserver_port"));
-  // sprintf(msgbuf, "CF:%s=[%d]", F("webserver_port"), cf_webserver_port); Output (msgbuf);
-
-  cf_urlpath        = SD_findCharStr(F("urlpath"));
-  sprintf(msgbuf, "CF:%s=[%s]", F("urlpath"), cf_urlpath); Output (msgbuf);
-  
-  cf_apikey         = SD_findCharStr(F("apikey"));
-  sprintf(msgbuf, "CF:%s=[%s]", F("apikey"), cf_apikey); Output (msgbuf);
-  
-  cf_instrument_id  = SD_findInt(F("instrument_id"));
-  sprintf(msgbuf, "CF:%s=[%d]", F("instrument_id"), cf_instrument_id); Output (msgbuf);
+  File fp;
+  char buf[64];
+  char line[LINE_MAX_LENGTH+1];
+  int len = 0;
+  bool truncated = false;
+  int n;
+  uint32_t size = 0;
+  uint32_t crc = 0;
+
+  if (SD_exists) {
+    fp = SD.open(CF_NAME, FILE_READ);
+  }
+  if (fp) {
+    while ((n = fp.read(buf, sizeof(buf))) > 0) {
+      size += n;
+      crc = crc32(crc, buf, n);
+      for (int i=0; i<n; i++) {
+        if (buf[i] == '\n') {
+          line[len] = 0;
+          SD_ConfigLine(line, truncated);
+          len = 0;
+          truncated = false;
+        }
+        else if (buf[i] == '\r') {
+          // trim the \r
+        }
+        else if (len < LINE_MAX_LENGTH) {
+          line[len++] = buf[i];
+        }
+        else {
+          truncated = true;
+        }
+      }
+    }
+
+    // Last line has no newline
+    if (len || truncated) {
+      line[len] = 0;
+      SD_ConfigLine(line, truncated);
+    }
+    fp.close();
 
-  //Time Server
-  cf_ntpserver      = SD_findCharStr(F("ntpserver"));
-  sprintf(msgbuf, "CF:%s=[%s]", F("ntpserver"), cf_ntpserver); Output (msgbuf);
+    NVM_Save(size, crc);
+  }
+  else {
+    sprintf (msgbuf, "CF:NO %s", CF_NAME);
+    Output (msgbuf);
+    if (NVM_Load()) {
+      Output ("CF:FROM FLASH");
+    }
+  }
 
-  // Distance
-  cf_ds_type   = SD_findInt(F("ds_type"));
-  sprintf(msgbuf, "CF:ds_type=[%d]", cf_ds_type); Output (msgbuf);
+  for (int i=0; i<CF_KEYS; i++) {
+    if (cf_keys[i].type == CF_INT) {
+      sprintf (msgbuf, "CF:%s=[%d]", cf_keys[i].key, *(int *)cf_keys[i].var);
+    }
+    else if (cf_keys[i].type == CF_FLOAT) {
+      float f = *(float *)cf_keys[i].var;
+      sprintf (msgbuf, "CF:%s=[%d.%02d]", cf_keys[i].key, (int)f, (int)(f*100)%100);
+    }
+    else {
+      sprintf (msgbuf, "CF:%s=[%s]", cf_keys[i].key, *(char **)cf_keys[i].var);
+    }
+    Output (msgbuf);
+  }
+
+  if (cf_unknown || cf_invalid) {
+    sprintf (msgbuf, "CF:%d UNKNOWN %d INVALID", cf_unknown, cf_invalid);
+    Output (msgbuf);
+  }
 }
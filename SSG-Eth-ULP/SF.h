@@ -252,6 +252,27 @@ void hexStringToByteArray(const char *hexString, uint8_t *byteArray, int len) {
     }
 }
 
+/*
+ * =======================================================================================================================
+ * crc32() - CRC-32 (IEEE, as zip and Ethernet) of len bytes, continuing from crc. Start with crc = 0
+ * =======================================================================================================================
+ */
+uint32_t crc32(uint32_t crc, const void *data, size_t len) {
+  static const uint32_t nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  const uint8_t *p = (const uint8_t *) data;
+
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+  }
+  return (~crc);
+}
+
 /*
  * ======================================================================================================================
  * JPO_ClearBits() - Clear System Status Bits related to initialization
@@ -38,10 +38,12 @@
 #include <SPI.h>
 #include <Wire.h>
 #include <ArduinoLowPower.h>
+#include <RTCZero.h>
 #include <SD.h>
 #include <ctime>                // Provides the tm structure
 #include <Ethernet3.h>          // Usi Ethernet3 for W5500 chip support. Does not support HTTPS
 #include <EthernetUdp3.h>
+#include <Dns.h>
 #include <Adafruit_BME280.h>
 #include <Adafruit_BMP280.h>
 #include <Adafruit_BMP3XX.h>
@@ -65,7 +67,7 @@
  * 10            D10      Used by Ether as SPI CS pin    Grove D4  (Particle Pin D5)
  * 9             D9/A7    Voltage Battery Pin            Grove D4  (Particle Pin D4)
  * 6             D6                                      Grove D2  (Particle Pin D3)
- * 5             D5                                      Grove D2  (Particle Pin D2)
+ * 5             D5       DS3231 INT/SQW Alarm Wakeup    Grove D2  (Particle Pin D2)
  * SCL           D3       i2c Clock                      Grove I2C_1
  * SDA           D2       i2c Data                       Grove I2C_1 
  * RST
@@ -114,10 +116,13 @@
 #define SSB_DS_1           0x2000   // Set if Dallas One WireSensor missing at startup
 #define SSB_SHT_1          0x4000   // Set if SHTX1 Sensor missing
 #define SSB_SHT_2          0x8000   // Set if SHTX2 Sensor missing
+#define SSB_PWR_TIER      0x30000   // Battery power tier 0-3, see PWR.h
 
 
 unsigned int SystemStatusBits = SSB_PWRON; // Set bit 0 for initial value power on. Bit 0 is cleared after first obs
 bool JustPoweredOn = true;         // Used to clear SystemStatusBits set during power on device discovery
+bool FastBoot = false;             // Skip startup delays after a brownout reset or with no serial console jumper
+bool ResetBoot = false;            // Brownout or watchdog reset, also skip the USB startup delays
 
 /*
  * =======================================================================================================================
@@ -130,7 +135,7 @@ char *msgp;                     // Pointer to message text
 char Buffer32Bytes[32];         // General storage
 
 #define MAX_OBS_SIZE  1024
-char obsbuf[MAX_OBS_SIZE];      // Url that holds observations for HTTP GET
+char obsbuf[MAX_OBS_SIZE];      // Url that holds observations for HTTP GET, or the JSON line for POST
 char *obsp;                     // Pointer to obsbuf
 
 int countdown = 1800;        // Exit calibration mode when reaches 0 - protects against burnt out pin or forgotten jumper
@@ -149,13 +154,21 @@ unsigned long startMillis = millis();
 #include "SF.h"                   // Support Functions
 #include "Output.h"               // OutPut support for OLED and Serial Console
 #include "CF.h"                   // Configuration File Variables
+#include "NVM.h"                  // Configuration Snapshot in Internal Flash
 #include "TM.h"                   // Time Management
+#include "GZ.h"                   // Gzip Body Encoder
 #include "ETH.h"                  // Ethernet suport
 #include "DS.h"                   // Dallas Sensor - One Wire
 #include "Sensors.h"              // I2C Based Sensors
 #include "SDC.h"                  // SD Card
+#include "BUS.h"                  // Shared SPI Bus
+#include "PROF.h"                 // Wake Cycle Profiler
 #include "DIST.h"                 // Distance Gauge for Stream/Snow 
+#include "PWR.h"                  // Battery Power Policy
+#include "UDP.h"                  // Observation Datagrams
+#include "MQTT.h"                 // MQTT 3.1.1 Publisher
 #include "OBS.h"                  // Do Observation Processing
+#include "SCH.h"                  // Task Scheduler
 #include "SM.h"                   // Station Monitor
 
 /* 
@@ -179,11 +192,24 @@ void setup()
   pinMode (LED_PIN, OUTPUT);
   digitalWrite(LED_PIN, LOW);
 
+  // After a brownout or when running unattended get to the first observation as fast as we can.
+  // The startup delays are only needed for a USB host and someone reading the display.
+  // The USB delays are kept on every power on, only a station recovering from a brownout or watchdog reset skips
+  // them to get back to observing.
+  pinMode(SCE_PIN, INPUT_PULLUP);
+  ResetBoot = (PM->RCAUSE.reg & (PM_RCAUSE_BOD12 | PM_RCAUSE_BOD33 | PM_RCAUSE_WDT)) != 0;
+  FastBoot = ResetBoot || (digitalRead(SCE_PIN) != LOW);
+
   Output_Initialize();
-  delay(2000); // Prevents usb driver crash on startup
+  if (!ResetBoot) {
+    delay(2000); // Prevents usb driver crash on startup
+  }
 
   Serial_writeln(COPYRIGHT);
   Output (VERSION_INFO);
+  if (FastBoot) {
+    Output ("BOOT:FAST");
+  }
 
   // Set up gauge pin for reading 
   pinMode(DISTANCE_PIN, INPUT);
@@ -191,12 +217,17 @@ void setup()
   // Initialize SD card if we have one.
   SD_initialize();
 
-  if (SD_exists && SD.exists(CF_NAME)) {
-    SD_ReadConfigFile();
-  }
-  else {
-    sprintf(msgbuf, "CF:NO %s", CF_NAME); Output (msgbuf);
-  }
+  // From CONFIG.TXT, or the flash snapshot of it if there is no SD card or file
+  SD_ReadConfigFile();
+
+  // SD was started at the slow init clock, bring it and the W5500 to the shared bus clock
+  BUS_Initialize();
+
+  // Take the W5500 out of reset now so it can auto-negotiate while we look for the RTC and sensors
+  Ethernet_Reset();
+
+  // Internal RTC wakes us from sleep, and is the clock if the DS3231 does not answer
+  rtcz.begin(false);
 
   // Read RTC and set system clock if RTC clock valid
   rtc_initialize();
@@ -211,9 +242,9 @@ void setup()
   rtc_timestamp();
   sprintf (msgbuf, "%s", timestamp);
   Output(msgbuf);
-  delay (2000);
-
-  Ethernet_Initialize();
+  if (!FastBoot) {
+    delay (2000);
+  }
 
   // Dallas Sensor
   dallas_sensor_init();
@@ -222,6 +253,14 @@ void setup()
   bmx_initialize();
   mcp9808_initialize();
   sht_initialize();
+
+  Ethernet_Initialize();
+
+  sprintf (msgbuf, "BOOT:%lums", millis());
+  Output (msgbuf);
+
+  PWR_Initialize();
+  SCH_Initialize();
 }
 
 /*
@@ -316,47 +355,6 @@ void loop()
 
   // Normal Operation
   else {
-    Ethernet_Renew_DHCP(); // Will just return if cf_ethernet_enable = 0
-    I2C_Check_Sensors();
-
-    now = rtc.now();
-    Time_of_obs = now.unixtime();
-    if ((now.year() >= TM_VALID_YEAR_START) && (now.year() <= TM_VALID_YEAR_END)) {
-      OBS_Do();
-    }
-    else {
-      Output ("OBS_Do() NotRun-Bad TM");
-    }
-
-    // Shutoff System Status Bits related to initialization after we have logged first observation
-    JPO_ClearBits();
-    
-    Output("Going to Sleep");
-
-    // Enable low power mode
-
-    if (cf_ethernet_enable) {
-      Ethernet.phyMode(POWER_DOWN);  // Puts the WIZ5500 PHY into power-down mode 13mA
-      Output("ETH:Sleeping");
-    }
-    
-    delay(2000);    
-    OLED_sleepDisplay();
-
-    // At this point we need to determine seconds to next 0, 15, 30, or 45 minute window
-    
-    LowPower.sleep(seconds_to_next_obs()*1000); // uses milliseconds
-
-    OLED_wakeDisplay();   // May need to toggle the Display reset pin.
-    delay(2000);
-    OLED_ClearDisplayBuffer(); 
-
-    Output("Wakeup");
-
-    if (cf_ethernet_enable) {
-      Ethernet.phyMode(ALL_AUTONEG);  // Restores the WIZ5500 PHY to normal operation 132mA when 100M & Transmitting
-      Output("ETH:Awake");
-    }
-
+    SCH_Run(); // Run tasks that are due, then sleep until the next one
   }
 }
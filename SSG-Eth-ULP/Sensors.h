@@ -78,13 +78,14 @@ bool MCP_2_exists = false;
  *   Chip ID BME280 = 0x60 temp, preasure, humidity - I2C ADDRESS 0x77  (SD0 to GND = 0x76)  Register 0xE0 = Reset
  *   Chip ID BMP388 = 0x50 temp, preasure           - I2C ADDRESS 0x77  (SD0 to GND = 0x76)
  *   Chip ID BMP390 = 0x60 temp, preasure           - I2C ADDRESS 0x77  (SD0 to GND = 0x76)
+ *   Probe details go to the serial console only, scrolling them on the OLED slows down boot
  *=======================================================================================================================
  */
 byte get_Bosch_ChipID (byte address) {
   byte chip_id = 0;
   byte error;
 
-  Output ("get_Bosch_ChipID()");
+  Serial_write ("get_Bosch_ChipID()");
   // The i2c_scanner uses the return value of
   // the Write.endTransmisstion to see if
   // a device did acknowledge to the address.
@@ -94,7 +95,7 @@ byte get_Bosch_ChipID (byte address) {
 
   // Check Register 0x00
   sprintf (msgbuf, "  I2C:%02X Reg:%02X", address, 0x00);
-  Output (msgbuf);
+  Serial_write (msgbuf);
   Wire.begin();
   Wire.beginTransmission(address);
   Wire.write(0x00);  // BM3 CHIPID REGISTER
@@ -106,39 +107,39 @@ byte get_Bosch_ChipID (byte address) {
     //  4:other error 
   if (error) {
     sprintf (msgbuf, "  ERR_ET:%d", error);
-    Output (msgbuf);
+    Serial_write (msgbuf);
   }
   else if (Wire.requestFrom(address, 1)) {  // Returns the number of bytes returned from the slave device 
     chip_id = Wire.read();
     if (chip_id == BMP280_CHIP_ID) { // 0x58
       sprintf (msgbuf, "  CHIPID:%02X BMP280", chip_id);
-      Output (msgbuf);
+      Serial_write (msgbuf);
       return (chip_id); // Found a Sensor!
     }
     else if (chip_id == BMP388_CHIP_ID) {
       sprintf (msgbuf, "  CHIPID:%02X BMP388", chip_id);
-      Output (msgbuf);
+      Serial_write (msgbuf);
       return (chip_id); // Found a Sensor!   
     }
     else if (chip_id == BME280_BMP390_CHIP_ID) {  // 0x60
       sprintf (msgbuf, "  CHIPID:%02X BME/390", chip_id);
-      Output (msgbuf);
+      Serial_write (msgbuf);
       return (chip_id); // Found a Sensor!   
     }
     else {
       sprintf (msgbuf, "  CHIPID:%02X InValid", chip_id);
-      Output (msgbuf);      
+      Serial_write (msgbuf);      
     }
   }
   else {
     sprintf (msgbuf, "  ERR_RF:0");
-    Output (msgbuf);
+    Serial_write (msgbuf);
   }
 
   // Check Register 0xD0
   chip_id = 0;
   sprintf (msgbuf, "  I2C:%02X Reg:%02X", address, 0xD0);
-  Output (msgbuf);
+  Serial_write (msgbuf);
   Wire.begin();
   Wire.beginTransmission(address);
   Wire.write(0xD0);  // BM2 CHIPID REGISTER
@@ -150,33 +151,33 @@ byte get_Bosch_ChipID (byte address) {
     //  4:other error 
   if (error) {
     sprintf (msgbuf, "  ERR_ET:%d", error);
-    Output (msgbuf);
+    Serial_write (msgbuf);
   }
   else if (Wire.requestFrom(address, 1)) {  // Returns the number of bytes returned from the slave device 
     chip_id = Wire.read(); 
     if (chip_id == BMP280_CHIP_ID) {  // 0x58
       sprintf (msgbuf, "  CHIPID:%02X BMP280", chip_id);
-      Output (msgbuf);
+      Serial_write (msgbuf);
       return (chip_id); // Found a Sensor!
     }
     else if (chip_id == BMP388_CHIP_ID) {  // 0x50
       sprintf (msgbuf, "  CHIPID:%02X BMP388", chip_id);
-      Output (msgbuf);
+      Serial_write (msgbuf);
       return (chip_id); // Found a Sensor!   
     }
     else if (chip_id == BME280_BMP390_CHIP_ID) {  // 0x60
       sprintf (msgbuf, "  CHIPID:%02X BME/390", chip_id);
-      Output (msgbuf);
+      Serial_write (msgbuf);
       return (chip_id); // Found a Sensor!   
     }
     else {
       sprintf (msgbuf, "  CHIPID:%02X InValid", chip_id);
-      Output (msgbuf);   
+      Serial_write (msgbuf);   
     }
   }
   else {
     sprintf (msgbuf, "  ERR_RF:0");
-    Output (msgbuf);
+    Serial_write (msgbuf);
   }
   return(0);
 }
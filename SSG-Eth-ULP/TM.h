@@ -18,6 +18,41 @@ char timestamp[32];
 bool RTC_valid = false;
 bool RTC_exists = false;
 
+/*
+ * ======================================================================================================================
+ *  RTC Alarm Wakeup
+ * 
+ *  The DS3231 INT/SQW pin is open drain and active low. When it is wired to RTC_ALARM_PIN, Alarm 1 wakes the MCU at 
+ *  the exact observation time. If the pin is not wired, or the alarm never arrives, the SAMD21 internal RTC (RTCZero)
+ *  is loaded from the DS3231 before each sleep and wakes us at the same absolute time.
+ * ======================================================================================================================
+ */
+#define RTC_ALARM_PIN           5       // D5 - DS3231 INT/SQW
+#define RTC_ALARM_BACKSTOP      2       // Seconds after the DS3231 alarm before the internal RTC wakes us
+
+RTCZero rtcz;                           // SAMD21 internal RTC, fallback wake source
+bool RTC_alarm_wake = false;            // True if the DS3231 INT pin was found wired to RTC_ALARM_PIN
+volatile bool rtc_alarm_fired = false;  // Set by DS3231 INT pin interrupt
+volatile bool rtcz_alarm_fired = false; // Set by internal RTC alarm interrupt
+
+/* 
+ *=======================================================================================================================
+ * rtc_alarm_isr() - DS3231 INT pin went low
+ *=======================================================================================================================
+ */
+void rtc_alarm_isr() {
+  rtc_alarm_fired = true;
+}
+
+/* 
+ *=======================================================================================================================
+ * rtcz_alarm_isr() - Internal RTC alarm matched
+ *=======================================================================================================================
+ */
+void rtcz_alarm_isr() {
+  rtcz_alarm_fired = true;
+}
+
 /* 
  *=======================================================================================================================
  * rtc_timestamp() - Read from RTC and set timestamp string
@@ -32,6 +67,114 @@ void rtc_timestamp() {
     now.hour(), now.minute(), now.second());
 }
 
+/* 
+ *=======================================================================================================================
+ * rtc_alarm_initialize() - Set DS3231 INT pin to alarm mode and see if it is wired to RTC_ALARM_PIN
+ *=======================================================================================================================
+ */
+void rtc_alarm_initialize() {
+  unsigned long t0;
+
+  pinMode(RTC_ALARM_PIN, INPUT_PULLUP);
+
+  rtc.disable32K();
+  rtc.writeSqwPinMode(DS3231_OFF);  // INTCN=1, alarms drive the INT pin instead of the square wave
+  rtc.disableAlarm(1);
+  rtc.disableAlarm(2);
+  rtc.clearAlarm(1);
+  rtc.clearAlarm(2);
+
+  // Probe the wiring. A once per second alarm must pull the pin low within a second.
+  RTC_alarm_wake = false;
+  if (rtc.setAlarm1(rtc.now(), DS3231_A1_PerSecond)) {
+    t0 = millis();
+    while ((digitalRead(RTC_ALARM_PIN) != LOW) && ((millis() - t0) < 1100)) {
+      delay (10);
+    }
+    RTC_alarm_wake = (digitalRead(RTC_ALARM_PIN) == LOW);
+  }
+  rtc.disableAlarm(1);
+  rtc.clearAlarm(1);                // Releases the INT pin
+
+  Output (RTC_alarm_wake ? "RTC:ALARM WAKE" : "RTC:ALARM NF");
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_epoch() - Set now and return unix time from the DS3231, or from the internal RTC when there is no DS3231
+ *=======================================================================================================================
+ */
+uint32_t rtc_epoch() {
+  if (RTC_exists) {
+    now = rtc.now();
+  }
+  else {
+    now = DateTime(rtcz.getEpoch());
+  }
+  return (now.unixtime());
+}
+
+/* 
+ *=======================================================================================================================
+ * rtc_sleep_until() - Low power sleep until unix time wake_time, return true if the DS3231 alarm woke us
+ *=======================================================================================================================
+ */
+bool rtc_sleep_until(uint32_t wake_time) {
+  bool ds_armed = false;
+
+  rtc_alarm_fired = false;
+  rtcz_alarm_fired = false;
+
+  // Reference the internal RTC to the DS3231 so both wake sources agree on the time. Without a DS3231 the internal
+  // RTC is the clock, begun in setup(), and its alarm is the only wake source.
+  if (RTC_exists) {
+    now = rtc.now();
+    rtcz.setEpoch(now.unixtime());
+  }
+  else {
+    now = DateTime(rtcz.getEpoch());
+  }
+
+  // The work before sleeping can take us past the deadline, an alarm set in the past would not match for a month
+  if (wake_time <= now.unixtime()) {
+    return (false);
+  }
+
+  if (RTC_alarm_wake) {
+    rtc.clearAlarm(1);
+    ds_armed = rtc.setAlarm1(DateTime(wake_time), DS3231_A1_Date);
+    if (ds_armed) {
+      LowPower.attachInterruptWakeup(RTC_ALARM_PIN, rtc_alarm_isr, FALLING);
+    }
+  }
+
+  // Internal RTC wakes us if there is no DS3231 alarm, otherwise it is a backstop for a missed alarm
+  rtcz.setAlarmEpoch(ds_armed ? (wake_time + RTC_ALARM_BACKSTOP) : wake_time);
+  rtcz.enableAlarm(rtcz.MATCH_YYMMDDHHMMSS);
+  rtcz.attachInterrupt(rtcz_alarm_isr);
+
+  // Other interrupts (USB) can wake us early, go back to sleep until one of our alarms fires. The deadline may
+  // also go by while the alarms are armed, then neither would match.
+  while (!rtc_alarm_fired && !rtcz_alarm_fired && (rtcz.getEpoch() < wake_time)) {
+    LowPower.sleep();
+  }
+
+  rtcz.disableAlarm();
+  rtcz.detachInterrupt();
+
+  if (ds_armed) {
+    detachInterrupt(digitalPinToInterrupt(RTC_ALARM_PIN));
+    rtc.disableAlarm(1);
+    rtc.clearAlarm(1);
+    if (rtcz_alarm_fired && !rtc_alarm_fired) {
+      // Backstop woke us. Stop trusting the INT pin and wake from the internal RTC from now on.
+      RTC_alarm_wake = false;
+      Output ("RTC:ALARM MISSED");
+    }
+  }
+  return (rtc_alarm_fired);
+}
+
 /* 
  *=======================================================================================================================
  * rtc_initialize()
@@ -48,7 +191,9 @@ void rtc_initialize() {
   if (!I2C_Device_Exist(RTC_I2C_ADDRESS)) {
     Output("ERR:RTC-I2C NOTFOUND");
     SystemStatusBits |= SSB_RTC; // Turn on Bit
-    delay (5000);
+    if (!FastBoot) {
+      delay (5000);
+    }
     return;
   }
 
@@ -68,6 +213,8 @@ void rtc_initialize() {
   else {
     Output ("NEED TIME->RTC");
   }
+
+  rtc_alarm_initialize();
 }
 
 /*
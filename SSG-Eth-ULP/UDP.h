@@ -0,0 +1,159 @@
+/*
+ * ======================================================================================================================
+ *  UDP.h - Observation Datagrams
+ *
+ *  When udp_collector is set an observation is first sent as one UDP datagram holding its binary record, to a
+ *  collector that passes it on to Chords. The collector answers with an ACK carrying the record's sq. Without an
+ *  ACK the datagram is sent again, UDP_TRIES in all with the wait doubling each time, then OBS_Send() falls back to
+ *  HTTP. Tools/udp_collector.py is a collector for a Linux host.
+ *
+ *  Datagram  "SG" [UDP_VERSION] [instrument_id uint32] [key length] [apikey] [record]
+ *  ACK       "SA" [UDP_VERSION] [instrument_id uint32] [sq uint32]
+ *
+ *  The record is the full record from OBS.h, [length][OBS_SCHEMA]..., integers are little endian. A datagram sent
+ *  again, or an observation that also went by HTTP, has the same sq and the collector drops the repeat.
+ *
+ *  Each send is timed by transport. UDP_Stats() reports the energy per delivered observation of each at the send
+ *  current, prof_ma[PROF_SEND], counting the time of attempts that were not delivered.
+ * ======================================================================================================================
+ */
+#define UDP_VERSION       1
+#define UDP_LOCAL_PORT    2391      // NTP uses localPort
+#define UDP_TRIES         3
+#define UDP_ACK_MS        250       // Wait for the first ACK, doubled for each try after
+#define UDP_ACK_SIZE      11
+
+#define UDP_VIA_UDP       0
+#define UDP_VIA_HTTP      1
+#define UDP_VIA_MQTT      2
+#define UDP_VIAS          3
+
+typedef struct {
+  uint32_t tries;
+  uint32_t delivered;
+  uint32_t ms;                      // Time of all tries
+} UDP_COST;
+
+UDP_COST udp_cost[UDP_VIAS];               // Since boot, by UDP_VIA_ transport
+EthernetUDP udp_obs;
+IPAddress udp_ip;                   // Collector, looked up again after a send gets no ACK
+bool udp_ip_valid = false;
+bool udp_open = false;
+
+/*
+ * ======================================================================================================================
+ * UDP_Resolve() - Look up the collector's address, returns false if we don't have one
+ * ======================================================================================================================
+ */
+bool UDP_Resolve() {
+  DNSClient dns;
+
+  if (!udp_ip_valid) {
+    // Takes a dotted address as well as a name
+    dns.begin(Ethernet.dnsServerIP());
+    udp_ip_valid = (dns.getHostByName(cf_udp_collector, udp_ip) == 1);
+    if (!udp_ip_valid) {
+      Output ("UDP:DNS ERR");
+    }
+  }
+  return (udp_ip_valid);
+}
+
+/*
+ * ======================================================================================================================
+ * UDP_Close() - Give up our socket before the W5500 is reset and begun again, which closes it under us. A socket
+ *               kept after that may be another's by the time we send on it
+ * ======================================================================================================================
+ */
+void UDP_Close() {
+  if (udp_open) {
+    udp_obs.stop();
+    udp_open = false;
+  }
+  udp_ip_valid = false;  // DHCP may give us another DNS server
+}
+
+/*
+ * ======================================================================================================================
+ * UDP_Send() - Send a full record with sequence number sq as a datagram, returns 1 when the collector ACKs it
+ * ======================================================================================================================
+ */
+int UDP_Send(const uint8_t *rec, uint32_t sq) {
+  uint8_t pkt[8 + 64 + SD_REC_MAX];
+  uint8_t ack[UDP_ACK_SIZE];
+  uint32_t id = cf_instrument_id;
+  unsigned long t0, wait;
+  int keylen = strlen(cf_apikey);
+  int len = 0;
+
+  if (!Ethernet.link() || !ip_valid || !UDP_Resolve()) {
+    return (0);
+  }
+  if (!udp_open) {
+    udp_open = udp_obs.begin(UDP_LOCAL_PORT);
+  }
+
+  pkt[len++] = 'S';
+  pkt[len++] = 'G';
+  pkt[len++] = UDP_VERSION;
+  memcpy (&pkt[len], &id, 4);
+  len += 4;
+  pkt[len++] = keylen;
+  memcpy (&pkt[len], cf_apikey, keylen);
+  len += keylen;
+  memcpy (&pkt[len], rec, rec[SD_REC_LEN]);
+  len += rec[SD_REC_LEN];
+
+  wait = UDP_ACK_MS;
+  for (int t=0; t<UDP_TRIES; t++, wait*=2) {
+    udp_obs.beginPacket(udp_ip, cf_udp_port);
+    udp_obs.write(pkt, len);
+    udp_obs.endPacket();
+
+    // ACKs for datagrams we gave up on may still come in, only ours counts
+    t0 = millis();
+    while ((millis() - t0) < wait) {
+      if ((udp_obs.parsePacket() == UDP_ACK_SIZE) && (udp_obs.read(ack, UDP_ACK_SIZE) == UDP_ACK_SIZE) &&
+          (ack[0] == 'S') && (ack[1] == 'A') && (ack[2] == UDP_VERSION) &&
+          !memcmp(&ack[3], &id, 4) && !memcmp(&ack[7], &sq, 4)) {
+        sprintf (msgbuf, "UDP:ACK SQ%lu %d", (unsigned long) sq, t+1);
+        Output (msgbuf);
+        return (1);
+      }
+    }
+  }
+
+  sprintf (msgbuf, "UDP:NO ACK SQ%lu", (unsigned long) sq);
+  Output (msgbuf);
+  udp_ip_valid = false;  // The collector may have moved
+  return (0);
+}
+
+/*
+ * ======================================================================================================================
+ * UDP_Cost() - Add a send of ms by transport via to the delivery cost
+ * ======================================================================================================================
+ */
+void UDP_Cost(int via, unsigned long ms, bool delivered) {
+  udp_cost[via].tries++;
+  udp_cost[via].delivered += delivered;
+  udp_cost[via].ms += ms;
+}
+
+/*
+ * ======================================================================================================================
+ * UDP_Stats() - Output delivered/tries and mA*s per delivered observation of each transport
+ * ======================================================================================================================
+ */
+void UDP_Stats() {
+  const char *name[UDP_VIAS] = {"UDP", "HTTP", "MQTT"};
+
+  msgbuf[0] = 0;
+  for (int v=0; v<UDP_VIAS; v++) {
+    float mas = (udp_cost[v].delivered) ? udp_cost[v].ms * prof_ma[PROF_SEND] / 1000.0 / udp_cost[v].delivered : 0.0;
+
+    sprintf (msgbuf+strlen(msgbuf), "%s%s:%lu/%lu %d.%01dmAs", (v) ? " " : "", name[v],
+      (unsigned long) udp_cost[v].delivered, (unsigned long) udp_cost[v].tries, (int)mas, (int)(mas*10)%10);
+  }
+  Output (msgbuf);
+}
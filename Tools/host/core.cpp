@@ -0,0 +1,48 @@
+/*
+ * ======================================================================================================================
+ *  core.cpp - Host stand-in for the Arduino core functions, see stub/Arduino.h
+ * ======================================================================================================================
+ */
+#include <Arduino.h>
+#include <Wire.h>
+
+uint64_t host_us = 0;
+void (*host_pin_hook)(uint8_t pin, uint8_t val) = NULL;
+HardwareSerial Serial;
+TwoWire Wire;
+
+unsigned long millis() {
+  return (unsigned long) (host_us / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long) host_us;
+}
+
+void delay(unsigned long ms) {
+  host_us += (uint64_t) ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+  host_us += us;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (host_pin_hook) {
+    host_pin_hook(pin, val);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return HIGH;
+}
+
+int analogRead(uint8_t pin) {
+  return 0;
+}
+
+void analogWrite(uint8_t pin, int val) {
+}
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""
+fatimg.py - Make and check FAT16 SD card images for the host harnesses
+
+  python3 fatimg.py mkfs card.img 64              # 64MB card, one FAT16 partition, 2KB clusters
+  python3 fatimg.py mkfs card.img 256 --spc 64    # 32KB clusters, as SDHC cards come formatted
+  python3 fatimg.py check card.img                # FAT copies agree, chains are sound, nothing lost
+  python3 fatimg.py check card.img --list         # and each file with its size and MD5
+
+The image is a whole card, a partition table in block 0 and the partition from block 2048. check exits non zero
+when the two FATs differ, a chain is cross linked, broken or short of its file's size, or a cluster is allocated
+to no file. Chains longer than the file are listed as slack.
+"""
+import argparse
+import hashlib
+import struct
+import sys
+
+START = 2048                                  # First block of the partition
+RESERVED = 1
+FATS = 2
+ROOT_ENTRIES = 512
+
+
+def mkfs(path, mb, spc):
+    total = mb * 2048 - START
+    root = ROOT_ENTRIES * 32 // 512
+    fatsz = 1
+    while True:
+        clusters = (total - RESERVED - root - FATS * fatsz) // spc
+        need = ((clusters + 2) * 2 + 511) // 512
+        if need <= fatsz:
+            break
+        fatsz = need
+    if not 4085 <= clusters < 65525:
+        sys.exit("fatimg: %d clusters is not FAT16, change the size or --spc" % clusters)
+
+    with open(path, "wb") as f:
+        f.truncate(mb * 1024 * 1024)
+        mbr = bytearray(512)
+        struct.pack_into("<B3sB3sII", mbr, 446, 0, b"\x00\x02\x00", 0x06, b"\xFE\xFF\xFF", START, total)
+        mbr[510:512] = b"\x55\xAA"
+        f.write(mbr)
+
+        bs = bytearray(512)
+        bs[0:11] = b"\xEB\x3C\x90MSDOS5.0"
+        struct.pack_into("<HBHBHHBHHHII", bs, 11, 512, spc, RESERVED, FATS, ROOT_ENTRIES,
+                         total if total < 65536 else 0, 0xF8, fatsz, 63, 255, START, total if total >= 65536 else 0)
+        struct.pack_into("<BBBI11s8s", bs, 36, 0x80, 0, 0x29, 0x55AA1234, b"SSG        ", b"FAT16   ")
+        bs[510:512] = b"\x55\xAA"
+        f.seek(START * 512)
+        f.write(bs)
+        for n in range(FATS):
+            f.seek((START + RESERVED + n * fatsz) * 512)
+            f.write(b"\xF8\xFF\xFF\xFF")
+    print("%s: %dMB, %d clusters of %d blocks" % (path, mb, clusters, spc))
+
+
+class Volume:
+    def __init__(self, path):
+        self.img = open(path, "rb").read()
+        start = struct.unpack_from("<I", self.img, 446 + 8)[0]
+        if self.img[450] == 0 or start == 0:
+            start = 0                          # Super floppy
+        (bps, self.spc, rsv, nfat, rootent, tot16, _, fatsz, _, _, _, tot32) = struct.unpack_from(
+            "<HBHBHHBHHHII", self.img, start * 512 + 11)
+        if bps != 512 or fatsz == 0:
+            sys.exit("fatimg: not a FAT16 volume")
+        self.fat0 = (start + rsv) * 512
+        self.fatsz = fatsz * 512
+        self.nfat = nfat
+        self.root = self.fat0 + nfat * self.fatsz
+        self.data = (self.root // 512) + rootent * 32 // 512
+        self.rootent = rootent
+        total = tot16 or tot32
+        self.clusters = (total - (self.data - start)) // self.spc
+        self.errors = 0
+
+    def error(self, msg):
+        print("ERROR " + msg)
+        self.errors += 1
+
+    def fat(self, c):
+        return struct.unpack_from("<H", self.img, self.fat0 + c * 2)[0]
+
+    def cluster(self, c):
+        o = (self.data + (c - 2) * self.spc) * 512
+        return self.img[o:o + self.spc * 512]
+
+    def chain(self, c, path):
+        out = []
+        while 2 <= c < 0xFFF8:
+            if c > self.clusters + 1:
+                self.error("%s: cluster %d past the end" % (path, c))
+                break
+            if c in self.used:
+                self.error("%s: cluster %d cross linked with %s" % (path, c, self.used[c]))
+                break
+            self.used[c] = path
+            out.append(c)
+            c = self.fat(c)
+        else:
+            if c < 0xFFF8:
+                self.error("%s: chain ends in %#x" % (path, c))
+        return out
+
+    def walk(self, raw, path, out):
+        for i in range(0, len(raw), 32):
+            e = raw[i:i + 32]
+            if e[0] == 0:
+                break
+            if e[0] == 0xE5 or e[11] == 0x0F or e[11] & 0x08:
+                continue
+            name = e[0:8].decode("ascii", "replace").rstrip()
+            ext = e[8:11].decode("ascii", "replace").rstrip()
+            name += "." + ext if ext else ""
+            if name in (".", ".."):
+                continue
+            first = struct.unpack_from("<H", e, 26)[0]
+            size = struct.unpack_from("<I", e, 28)[0]
+            chain = self.chain(first, path + name) if first else []
+            if e[11] & 0x10:
+                self.walk(b"".join(self.cluster(c) for c in chain), path + name + "/", out)
+                continue
+            need = (size + self.spc * 512 - 1) // (self.spc * 512)
+            if len(chain) < need:
+                self.error("%s: %d bytes in %d clusters" % (path + name, size, len(chain)))
+            data = b"".join(self.cluster(c) for c in chain)[:size]
+            out.append((path + name, size, hashlib.md5(data).hexdigest(), len(chain) - need))
+
+    def check(self, listing):
+        for n in range(1, self.nfat):
+            o = self.fat0 + n * self.fatsz
+            if self.img[o:o + self.fatsz] != self.img[self.fat0:self.fat0 + self.fatsz]:
+                self.error("FAT %d differs from FAT 0" % n)
+        self.used = {}
+        files = []
+        self.walk(self.img[self.root:self.root + self.rootent * 32], "/", files)
+        lost = [c for c in range(2, self.clusters + 2) if self.fat(c) and c not in self.used]
+        if lost:
+            self.error("%d clusters allocated to no file" % len(lost))
+        for path, size, md5, slack in files:
+            if listing:
+                print("%-32s %9d %s" % (path, size, md5))
+            if slack > 0:
+                print("slack %s %d clusters" % (path, slack))
+        free = sum(1 for c in range(2, self.clusters + 2) if self.fat(c) == 0)
+        print("%d files, %d of %d clusters free, %d errors" % (len(files), free, self.clusters, self.errors))
+        return self.errors == 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    m = sub.add_parser("mkfs")
+    m.add_argument("image")
+    m.add_argument("mb", type=int)
+    m.add_argument("--spc", type=int, default=4, help="blocks per cluster")
+    c = sub.add_parser("check")
+    c.add_argument("image")
+    c.add_argument("--list", action="store_true")
+    args = ap.parse_args()
+
+    if args.cmd == "mkfs":
+        mkfs(args.image, args.mb, args.spc)
+    elif not Volume(args.image).check(args.list):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,321 @@
+/*
+ * ======================================================================================================================
+ *  n2s_test.cpp - Each N2S record sent once, by every drain order, GET, POST batch and MQTT window
+ *
+ *  Builds OBS.h from the sketch on the card emulator, with the sensors, the web server and the MQTT broker stubbed
+ *  out here. Records whose sq is their place in the N2S file are added, then OBS_N2S_Publish() is run until it
+ *  removes the N2S files. The server and broker take every record and count each sq they get. A record is only
+ *  marked in the N2S index once its POST or PUBACK is in, so a drain order that gives an entry twice sends it twice
+ *  with http_batch or the MQTT window above 1. Each run checks:
+ *
+ *    Every record is sent exactly once, over one drain or over many cut short by the budget
+ *    A POST carries more than one record and more than one publish waits for its PUBACK, where the run allows it
+ *
+ *    n2s_test card.img [-v]            # card from fatimg.py mkfs, -v lists every run
+ *
+ *  Exits non zero if a check fails.
+ * ======================================================================================================================
+ */
+#define STATION_OBS
+#include <ctime>
+#include "station.h"
+#include "QC.h"
+
+#define START       1767225600UL      // 2026-01-01 00:00:00
+#define MAX_RECS    200
+#define SEND_MS     150               // Time the server takes for a request
+#define PUB_MS      20                // Time to write a publish
+#define ACK_MS      200               // Time from a publish to its PUBACK
+
+// Sketch globals and functions OBS.h uses, see SSG-Eth-ULP.ino and the headers it includes before OBS.h
+#define MAX_OBS_SIZE            1024
+#define BMP280_CHIP_ID          0x58
+#define BME280_BMP390_CHIP_ID   0x60
+#define BMX_TYPE_BME280         1
+#define BMX_TYPE_BMP390         2
+#define PWR_SEND_NOW            0
+
+typedef enum {PROF_WAKE, PROF_TAKE, PROF_LOG, PROF_SEND, PROF_N2S, PROF_DHCP, PROF_QUIET, PROF_SLEEP,
+  PROF_PHASES} PROF_PHASE;
+const char *prof_id[PROF_PHASES] = {"wk", "tk", "lg", "sn", "ns", "dh", "qt", "sl"};
+unsigned long prof_ms[PROF_PHASES];
+float prof_mas = 0.0;
+bool prof_valid = false;
+
+struct {
+  int send;
+} pwr_tiers[1] = {{PWR_SEND_NOW}};
+int pwr_tier = 0;
+
+char obsbuf[MAX_OBS_SIZE];
+char Buffer32Bytes[32];
+
+struct SENSOR_STUB {
+  float readPressure() { return (NAN); }
+  float readTemperature() { return (NAN); }
+  float readHumidity() { return (NAN); }
+  float readTempC() { return (NAN); }
+} bmp1, bmp2, bme1, bme2, bm31, bm32, mcp1, mcp2, sht1, sht2;
+byte BMX_1_chip_id = 0, BMX_2_chip_id = 0, BMX_1_type = 0, BMX_2_type = 0;
+bool BMX_1_exists = false, BMX_2_exists = false;
+bool MCP_1_exists = false, MCP_2_exists = false;
+bool SHT_1_exists = false, SHT_2_exists = false;
+bool ds_found = false;
+float ds_reading = 0.0;
+
+void Serial_writeln(const char *str) {}
+void getDSTemp() {}
+float Distance_Median() { return (0.0); }
+void I2C_Check_Sensors() {}
+void PROF_Begin(int phase) {}
+void PROF_End(int phase) {}
+void BUS_Stats() {}
+uint32_t NVM_SeqNext(uint32_t floor) { return (floor); }
+#define NVM_SEQ_EPOCH           1577836800UL
+
+#define UDP_VIA_UDP             0
+#define UDP_VIA_HTTP            1
+#define UDP_VIA_MQTT            2
+void UDP_Cost(int via, unsigned long ms, bool delivered) {}
+int UDP_Send(const uint8_t *rec, uint32_t sq) { return (0); }
+void UDP_Stats() {}
+
+// What the server and broker got
+int sends[MAX_RECS];                // By sq
+int posts = 0;
+int post_max = 0;                   // Most records in one POST
+int flying_max = 0;                 // Most publishes waiting for their PUBACK
+uint32_t budget = 0;                // ms SCH_N2S_Budget() gives a drain
+bool verbose = false;
+int failures = 0;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf ("FAIL %s:%d ", __FILE__, __LINE__); \
+  printf (__VA_ARGS__); printf ("\n"); } } while (0)
+
+/*
+ * ======================================================================================================================
+ * Take() - Count each sq in s, after key, returns how many
+ * ======================================================================================================================
+ */
+int Take(const char *s, const char *key) {
+  int n = 0;
+
+  for (s=strstr(s, key); s; s=strstr(s, key)) {
+    int sq = atoi(s += strlen(key));
+
+    CHECK((sq >= 0) && (sq < MAX_RECS), "sq %d", sq);
+    if ((sq >= 0) && (sq < MAX_RECS)) {
+      sends[sq]++;
+    }
+    n++;
+  }
+  return (n);
+}
+
+// The web server, see ETH.h. A POST body is kept until Ethernet_Response()
+class HostClient : public Print {
+  public:
+    char body[8192];
+    int len = 0;
+    size_t write(uint8_t c) {
+      if (len < (int) sizeof(body) - 1) {
+        body[len++] = c;
+      }
+      return (1);
+    }
+    using Print::write;
+    void stop() {}
+};
+HostClient client;
+
+#define ETH_POST_TAIL "]}"
+
+int Ethernet_PostHead(char *buf) {
+  return (sprintf (buf, "{\"instrument_id\":%d,\"key\":\"%s\",\"obs\":[", cf_instrument_id, cf_apikey));
+}
+
+bool Ethernet_PostBegin(uint32_t len, bool gzip) {
+  client.len = 0;
+  return (true);
+}
+
+int Ethernet_Response() {
+  int n;
+
+  client.body[client.len] = 0;
+  n = Take(client.body, "\"sq\":");
+  post_max = (n > post_max) ? n : post_max;
+  posts++;
+  delay (SEND_MS);
+  return (1);
+}
+
+int Ethernet_Send(char *obs) {
+  Take(obs, "&sq=");
+  delay (SEND_MS);
+  return (1);
+}
+
+// The MQTT broker, see MQTT.h. Each publish is acknowledged ACK_MS after it, in order
+#define MQTT_PUBACK       0x40
+#define MQTT_TIMEOUT      5000
+#define MQTT_WINDOW       8
+
+char mqtt_payload[MAX_OBS_SIZE];
+uint16_t mqtt_pid = 0;
+uint16_t mqtt_acks[MAX_RECS];       // Packet ids to acknowledge and when
+unsigned long mqtt_ack_ms[MAX_RECS];
+int mqtt_ack_first = 0, mqtt_ack_n = 0;
+extern int obs_n2s_flying;
+
+struct {
+  bool available() { return ((mqtt_ack_first < mqtt_ack_n) && (millis() >= mqtt_ack_ms[mqtt_ack_first])); }
+  void stop() {}
+} mqtt_client;
+
+bool MQTT_Connect() { return (true); }
+char *MQTT_Payload() { mqtt_payload[0] = 0; return (mqtt_payload); }
+int MQTT_Send() { return (0); }
+
+bool MQTT_Publish(uint16_t *id) {
+  *id = ++mqtt_pid;
+  Take(mqtt_payload, "\"sq\":");
+  delay (PUB_MS);
+  if (mqtt_ack_n < MAX_RECS) {
+    mqtt_acks[mqtt_ack_n] = *id;
+    mqtt_ack_ms[mqtt_ack_n++] = millis() + ACK_MS;
+  }
+  flying_max = (obs_n2s_flying + 1 > flying_max) ? obs_n2s_flying + 1 : flying_max;
+  return (true);
+}
+
+uint8_t MQTT_Read(unsigned long timeout, uint16_t *id) {
+  if (mqtt_ack_first == mqtt_ack_n) {
+    delay (timeout);
+    return (0);
+  }
+  if (millis() < mqtt_ack_ms[mqtt_ack_first]) {
+    delay (mqtt_ack_ms[mqtt_ack_first] - millis());
+  }
+  *id = mqtt_acks[mqtt_ack_first++];
+  return (MQTT_PUBACK);
+}
+
+uint32_t SCH_N2S_Budget(uint32_t left) {
+  return (budget);
+}
+
+#include "GZ.h"
+#include "OBS.h"
+
+typedef enum {VIA_GET, VIA_POST, VIA_MQTT} VIA;
+const char *vias[] = {"GET", "POST", "MQTT"};
+const char *drains[] = {"fifo", "lifo", "decimate"};
+
+/*
+ * ======================================================================================================================
+ * Run() - Add count records to N2S and drain them by via in the order drain, each drain given ms
+ * ======================================================================================================================
+ */
+void Run(VIA via, int drain, int decimate, int batch, int count, uint32_t ms) {
+  uint8_t rec[SD_REC_MAX];
+  uint32_t fields = 1UL << OBS_FIELD_SQ;
+  int drained = 0;
+  int once = 0;
+
+  memset (sends, 0, sizeof(sends));
+  posts = post_max = flying_max = 0;
+  mqtt_ack_first = mqtt_ack_n = 0;
+
+  memset (rec, 0, sizeof(rec));
+  rec[SD_REC_LEN] = OBS_REC_DATA + 4;
+  rec[SD_REC_SCHEMA] = OBS_SCHEMA;
+  memcpy (&rec[OBS_REC_FIELDS], &fields, 4);
+  for (int32_t sq=0; sq<count; sq++) {
+    uint32_t ts = millis() / 1000;
+
+    memcpy (&rec[OBS_REC_TS], &ts, 4);
+    memcpy (&rec[OBS_REC_DATA], &sq, 4);
+    SD_NeedToSend_Add(rec);
+  }
+
+  cf_n2s_drain = drain;
+  cf_n2s_decimate = decimate;
+  cf_http_post = (via == VIA_POST);
+  cf_http_batch = batch;
+  cf_mqtt_broker = (char *) ((via == VIA_MQTT) ? "broker" : "");
+  budget = ms;
+  obs_n2s_rtt = 0;
+  while (SD.exists(SD_n2s_file) && (drained < count + 1)) {
+    OBS_N2S_Publish();
+    drained++;
+    delay (1000);
+  }
+
+  for (int sq=0; sq<count; sq++) {
+    once += (sends[sq] == 1);
+  }
+  CHECK(once == count, "%s %s/%d batch %d budget %lums: %d of %d sent once", vias[via], drains[drain], decimate,
+    batch, (unsigned long) ms, once, count);
+  for (int sq=0; (sq<count) && (once != count); sq++) {
+    if (sends[sq] != 1) {
+      printf ("  sq %d sent %d times\n", sq, sends[sq]);
+    }
+  }
+  CHECK(!SD.exists(SD_n2s_file), "%s %s: N2S left after %d drains", vias[via], drains[drain], drained);
+  if ((via == VIA_POST) && (batch > 1) && (count > 1)) {
+    CHECK(post_max > 1, "%s batch %d: no POST of more than one record", vias[via], batch);
+  }
+  if ((via == VIA_MQTT) && (count > 1)) {
+    CHECK(flying_max > 1, "%s: no more than one publish waiting", vias[via]);
+  }
+  if (verbose) {
+    printf ("%-4s %-8s /%-2d batch %-2d budget %6lums %3d records %2d drains, %3d POSTs of up to %2d, "
+      "up to %d waiting\n", vias[via], drains[drain], decimate, batch, (unsigned long) ms, count, drained, posts,
+      post_max, flying_max);
+  }
+}
+
+int main(int argc, char **argv) {
+  const int batches[] = {1, 7, 20};
+  const int decimates[] = {2, 5, 12};
+  const int counts[] = {1, 12, 100, 199};
+  const uint32_t budgets[] = {600000, 1500};
+  int runs = 0;
+
+  verbose = (argc > 2) && !strcmp(argv[2], "-v");
+  if ((argc < 2) || !SDEMU_Open(argv[1], SD_ChipSelect)) {
+    printf ("usage: n2s_test card.img [-v]\n");
+    return (1);
+  }
+  Station_Clock(START);
+  SD_initialize();
+  if (!SD_exists) {
+    printf ("SD_initialize failed\n");
+    return (1);
+  }
+  SD.setClock(cf_spi_mhz * 1000000UL);
+  cf_ethernet_enable = 1;
+
+  for (int drain=OBS_N2S_FIFO; drain<=OBS_N2S_DECIMATE; drain++) {
+    for (unsigned d=0; d<sizeof(decimates) / sizeof(decimates[0]); d++) {
+      if ((drain != OBS_N2S_DECIMATE) && d) {
+        continue;
+      }
+      for (unsigned c=0; c<sizeof(counts) / sizeof(counts[0]); c++) {
+        for (unsigned b=0; b<sizeof(budgets) / sizeof(budgets[0]); b++) {
+          Run(VIA_GET, drain, decimates[d], 1, counts[c], budgets[b]);
+          Run(VIA_MQTT, drain, decimates[d], 1, counts[c], budgets[b]);
+          for (unsigned n=0; n<sizeof(batches) / sizeof(batches[0]); n++) {
+            Run(VIA_POST, drain, decimates[d], batches[n], counts[c], budgets[b]);
+          }
+          runs += 5;
+        }
+      }
+    }
+  }
+
+  SDEMU_Close();
+  printf ("n2s_test: %d runs, %d failures\n", runs, failures);
+  return (failures != 0);
+}
@@ -0,0 +1,146 @@
+#!/bin/sh
+#
+# run.sh - Build and run the SSG-Eth-ULP host harnesses with g++
+#
+# Sketch headers and the SD library are built as they are, the Arduino core is the stand-in in stub/ with a
+# virtual clock. The SD card is the emulator in sdemu.cpp on an image made by fatimg.py, which checks the image
+# after each run. Nothing here is part of the station build.
+#
+#   Tools/host/run.sh                 # build and run them all
+#   Tools/host/run.sh sch_test -v     # one harness, with its arguments
+#
+# Binaries and card images go to $BUILD, /tmp/ssg-host by default. Exits non zero if a build or a check fails.
+#
+HOST=$(cd "$(dirname "$0")" && pwd)
+REPO=$(cd "$HOST/../.." && pwd)
+BUILD=${BUILD:-/tmp/ssg-host}
+CXX=${CXX:-g++}
+CXXFLAGS="-std=gnu++11 -O1 -g -Wall -Wno-unused-variable -Wno-unused-function -I$HOST/stub"
+SD="$REPO/libraries/SD/src"
+# Commit before the SdVolume LRU cache, sd_cache compares with its single block cache
+SD_OLD_CACHE=5362b24
+# Sketch headers are written for 32 bit long and size_t, their format and sign warnings are not the host's to fix
+SKETCH="-I$REPO/SSG-Eth-ULP -Wno-format -Wno-sign-compare -Wno-write-strings"
+
+mkdir -p "$BUILD" || exit 1
+
+# sdlib lib src flags... - Compile the SD library in src into $BUILD/lib as the SAMD21 build sees it, with flags
+#                          such as -DSD_CACHE_BLOCKS=2. Its own warnings are not ours. SdFatUtil.h is skipped, its
+#                          FreeRam() casts pointers to int and nothing calls it.
+sdlib() {
+  lib=$1
+  src=$2
+  shift 2
+  echo "-D__arm__ -DARDUINO_ARCH_SAMD -DSdFatUtil_h -I$src -I$src/utility $*" > "$BUILD/$lib.flags"
+  mkdir -p "$BUILD/$lib" || exit 1
+  for f in "$src/SD.cpp" "$src/File.cpp" "$src"/utility/*.cpp; do
+    $CXX $CXXFLAGS -w $(cat "$BUILD/$lib.flags") -c "$f" -o "$BUILD/$lib/$(basename "$f" .cpp).o" || exit 1
+  done
+}
+
+# build name sources... - Compile a harness
+build() {
+  bin=$1
+  shift
+  $CXX $CXXFLAGS -o "$BUILD/$bin" "$@" "$HOST/core.cpp" || exit 1
+}
+
+# sdbuild name lib sources... - Compile a harness with an SD library from sdlib and the card emulator
+sdbuild() {
+  bin=$1
+  lib=$2
+  shift 2
+  build $bin "$@" $(cat "$BUILD/$lib.flags") "$HOST/sdemu.cpp" "$BUILD/$lib"/*.o
+}
+
+# card name mb spc - Make a card image
+card() {
+  python3 "$HOST/fatimg.py" mkfs "$BUILD/$1.img" $2 --spc $3 > /dev/null || exit 1
+}
+
+# exe name args... - Run a harness, then check the card images it leaves. The files on each are listed in its
+#                   .list for comparing runs.
+exe() {
+  bin=$1
+  shift
+  "$BUILD/$bin" "$@" || exit 1
+  for img in "$BUILD"/*.img; do
+    [ -f "$img" ] || continue
+    python3 "$HOST/fatimg.py" check --list "$img" > "${img%.img}.list" || { cat "${img%.img}.list"; exit 1; }
+    rm -f "$img"
+  done
+}
+
+# run name args... - Build and run a harness
+run() {
+  name=$1
+  shift
+  case $name in
+    sch_test)
+      build sch_test -I"$REPO/SSG-Eth-ULP" "$HOST/sch_test.cpp"
+      exe sch_test "$@"
+      ;;
+    n2s_test)
+      sdlib sd "$SD"
+      sdbuild n2s_test sd $SKETCH "$HOST/n2s_test.cpp"
+      card n2s 64 4
+      exe n2s_test "$BUILD/n2s.img" "$@"
+      ;;
+    sd_multi)
+      sdlib sd "$SD"
+      sdbuild sd_multi sd "$HOST/sd_multi.cpp"
+      card multi 256 64
+      exe sd_multi "$BUILD/multi.img" "$@"
+      ;;
+    sd_obs)
+      sdlib sd "$SD"
+      sdbuild sd_obs sd $SKETCH "$HOST/sd_obs.cpp"
+      card obs 256 64
+      exe sd_obs "$BUILD/obs.img" "$@"
+      ;;
+    sd_layout)
+      sdlib sd "$SD"
+      sdbuild sd_layout sd $SKETCH "$HOST/sd_layout.cpp"
+      card layout 64 4
+      exe sd_layout "$BUILD/layout.img" "$@"
+      ;;
+    sd_cache)
+      # The FAT map is left out so only the cache differs from the old library
+      rm -rf "$BUILD/old" && mkdir -p "$BUILD/old" || exit 1
+      git -C "$REPO" archive $SD_OLD_CACHE libraries/SD/src | tar -x -C "$BUILD/old" || exit 1
+      sdlib sd-old "$BUILD/old/libraries/SD/src"
+      sdbuild sd_cache-old sd-old "$HOST/sd_cache.cpp"
+      printf "%-12s" "old cache"
+      card cache 64 4
+      exe sd_cache-old "$BUILD/cache.img" "$@"
+      for n in 2 3 4; do
+        sdlib sd-cache$n "$SD" -DSD_CACHE_BLOCKS=$n -DSD_FAT_MAP_BYTES=0
+        sdbuild sd_cache$n sd-cache$n "$HOST/sd_cache.cpp"
+        printf "%-12s" "$n blocks"
+        card cache 64 4
+        exe sd_cache$n "$BUILD/cache.img" "$@"
+      done
+      ;;
+    sd_fatmap)
+      for n in 0 512; do
+        sdlib sd-fatmap$n "$SD" -DSD_FAT_MAP_BYTES=$n
+        sdbuild sd_fatmap$n sd-fatmap$n $SKETCH "$HOST/sd_fatmap.cpp"
+        card fatmap$n 64 4
+        exe sd_fatmap$n "$BUILD/fatmap$n.img" "$@"
+      done
+      cmp -s "$BUILD/fatmap0.list" "$BUILD/fatmap512.list" || { echo "sd_fatmap: the cards differ"; exit 1; }
+      ;;
+    *)
+      echo "run.sh: no harness $name" >&2
+      exit 1
+      ;;
+  esac
+}
+
+if [ $# -gt 0 ]; then
+  run "$@"
+else
+  for h in sch_test n2s_test sd_multi sd_obs sd_cache sd_layout sd_fatmap; do
+    run $h
+  done
+fi
@@ -0,0 +1,354 @@
+/*
+ * ======================================================================================================================
+ *  sch_test.cpp - Scheduler decisions on a virtual clock
+ *
+ *  Builds SCH.h and PWR.h from the sketch with the rest of the station stubbed out. SCH_Clock reads the virtual
+ *  clock, SCH_Sleep moves it to the wake time and each task moves it by the time it takes on a station. Three
+ *  days are run with the battery falling through every power tier and back, and each run and sleep is checked:
+ *
+ *    OBS1 runs once, first, at boot and its slot is freed
+ *    Tasks due together run in table order, periodic runs land on their boundaries or after a task that ran over
+ *    A sleep never passes a deadline and wakes at the earliest one
+ *    Each tier change leaves every task with that tier's period and flags, on the new boundaries
+ *    Network tasks run with the PHY awake, quiet tasks do not wake it
+ *
+ *  Exits non zero if a check fails. -v lists every run.
+ * ======================================================================================================================
+ */
+#include <Arduino.h>
+#include <RTClib.h>
+
+// Sketch globals and functions SCH.h and PWR.h use, see SSG-Eth-ULP.ino
+#define TM_VALID_YEAR_START     2024
+#define TM_VALID_YEAR_END       2033
+#define SSB_N2S                 0x10
+#define SSB_PWR_TIER            0x30000
+#define DISTANCE_SAMPLE_PERIOD  15
+#define ALL_AUTONEG             0
+#define POWER_DOWN              1
+
+typedef enum {PROF_WAKE, PROF_N2S, PROF_DHCP, PROF_QUIET, PROF_PHASES} PROF_PHASE;
+const float prof_ma[PROF_PHASES] = {85.0, 152.0, 152.0, 21.0};
+
+char msgbuf[1024];
+unsigned int SystemStatusBits = SSB_N2S;
+bool SerialConsoleEnabled = false;
+bool ip_valid = true;
+int cf_ethernet_enable = 1;
+int cf_sd_sync = 0;
+char *cf_mqtt_broker = (char *) "";
+float cf_pwr_conserve = 3.70;
+float cf_pwr_batch = 3.55;
+float cf_pwr_logonly = 3.40;
+unsigned int distance_samples = 60;
+uint32_t obs_n2s_rtt = 0;
+unsigned long Time_of_obs = 0;
+RTC_DS3231 rtc;
+DateTime now;
+
+struct {
+  void phyMode(int mode) {}
+} Ethernet;
+
+// What the harness sees of the run
+#define MAX_RUNS 32768
+
+typedef struct {
+  uint32_t    t;                    // Clock when the task started
+  uint32_t    end;
+  const char  *name;
+  int         tier;                 // Power tier the task was scheduled in
+  bool        eth_awake;
+  int         sleep;                // Sleeps before it
+} RUN;
+
+RUN runs[MAX_RUNS];
+int nruns = 0;
+int sleeps = 0;
+char sch_last[16] = "";             // Name of the last non quiet task from its "SCH:" output
+int sch_tier = 0;                   // Power tier when it was started, OBS may change it
+int failures = 0;
+bool verbose = false;
+float volts = 4.0;                  // Battery the OBS task reads
+
+extern int pwr_tier;
+
+#define CHECK(cond, ...) do { if (!(cond)) { failures++; printf ("FAIL %s:%d ", __FILE__, __LINE__); \
+  printf (__VA_ARGS__); printf ("\n"); } } while (0)
+
+uint32_t VClock() {
+  return (uint32_t) (host_us / 1000000);
+}
+
+void Elapse(uint32_t seconds) {
+  host_us += (uint64_t) seconds * 1000000;
+}
+
+void Output(const char *str) {
+  if (!strncmp(str, "SCH:", 4)) {
+    snprintf (sch_last, sizeof(sch_last), "%s", str + 4);
+    sch_tier = pwr_tier;
+  }
+  if (verbose) {
+    printf ("%10u %s\n", VClock(), str);
+  }
+}
+
+void Record(const char *name, uint32_t seconds);
+
+// Stubbed station, each takes about its time on a station
+void Distance_Sample()         { Record("GAUGE", 1); }
+void I2C_Check_Sensors()       { Record("I2C", 0); }
+void Ethernet_Renew_DHCP()     { Record("DHCP", 2); }
+void Ethernet_UpdateTime()     { Record("NTP", 1); }
+void OBS_N2S_Publish()         { Record("N2S", 10); }
+void OBS_Do()                  { Record(strcmp(sch_last, "OBS1") ? "OBS" : "OBS1", 20); }
+uint32_t OBS_N2S_Gap()         { return 0; }
+float vbat_get()               { return volts; }
+void JPO_ClearBits()           {}
+void PROF_Begin(PROF_PHASE p)  {}
+void PROF_End(PROF_PHASE p)    {}
+void PROF_Cycle()              {}
+void PROF_Sleep(uint32_t s)    {}
+void OLED_wakeDisplay()        {}
+void OLED_ClearDisplayBuffer() {}
+void OLED_sleepDisplay()       {}
+void Ethernet_WaitLink()       { Elapse(2); }
+void MQTT_Disconnect()         {}
+void SD_Sync()                 {}
+void SD_LogText(const char *s) {}
+bool rtc_sleep_until(uint32_t wake_time) { return true; }
+uint32_t rtc_epoch()           { now = rtc.now(); return (now.unixtime()); }
+
+#include "PWR.h"
+#include "SCH.h"
+
+void Record(const char *name, uint32_t seconds) {
+  if (nruns == MAX_RUNS) {
+    printf ("FAIL %s runs away at %u\n", name, VClock());
+    exit (1);
+  }
+  else {
+    runs[nruns].t = VClock();
+    runs[nruns].name = name;
+    runs[nruns].end = runs[nruns].t + seconds;
+    runs[nruns].tier = strncmp(name, "OBS", 3) ? pwr_tier : sch_tier;
+    runs[nruns].eth_awake = sch_eth_awake;
+    runs[nruns].sleep = sleeps;
+    if (verbose) {
+      printf ("%10u %-5s tier %d eth %d\n", runs[nruns].t, name, pwr_tier, sch_eth_awake);
+    }
+    nruns++;
+  }
+  Elapse(seconds);
+}
+
+/*
+ * ======================================================================================================================
+ * VSleep() - Sleep hook, check the wake time against the table then move the clock to it. The PHY and OLED are
+ *            put down as SCH_RTC_Sleep() does
+ * ======================================================================================================================
+ */
+void VSleep(uint32_t wake_time) {
+  uint32_t t = VClock();
+  uint32_t earliest = 0;
+
+  for (int i=0; i<SCH_MAX_TASKS; i++) {
+    if (sch_tasks[i].inuse && !(sch_tasks[i].flags & SCH_OFF)) {
+      CHECK(sch_tasks[i].next > t, "%s due at %u not run before sleep at %u", sch_tasks[i].name,
+        sch_tasks[i].next, t);
+      if (!earliest || (sch_tasks[i].next < earliest)) {
+        earliest = sch_tasks[i].next;
+      }
+    }
+  }
+  CHECK(wake_time > t, "sleep at %u to the past %u", t, wake_time);
+  CHECK(wake_time == earliest, "sleep at %u to %u, earliest deadline %u", t, wake_time, earliest);
+
+  sch_eth_awake = false;
+  sch_oled_awake = false;
+  sleeps++;
+  host_us = (uint64_t) wake_time * 1000000;
+}
+
+/*
+ * ======================================================================================================================
+ * CheckTier() - Every task has the period and flags of the current tier
+ * ======================================================================================================================
+ */
+void CheckTier() {
+  PWR_TIER *p = &pwr_tiers[pwr_tier];
+  uint32_t t = VClock();
+
+  struct {
+    int       id;
+    uint32_t  period;
+    byte      flags;
+  } want[] = {
+    {sch_gauge, p->gauge_period, SCH_QUIET},
+    {sch_obs,   p->obs_period,   (byte) ((p->send == PWR_SEND_NOW) ? SCH_NET : 0)},
+    {sch_dhcp,  p->net_period,   SCH_NET},
+    {sch_n2s,   p->net_period,   SCH_NET},
+    {sch_ntp,   (uint32_t) (p->net_period ? SCH_NTP_PERIOD : 0), SCH_NET},
+  };
+
+  for (unsigned i=0; i<sizeof(want)/sizeof(want[0]); i++) {
+    SCH_TASK *k = &sch_tasks[want[i].id];
+    if (want[i].period == 0) {
+      CHECK(k->flags & SCH_OFF, "tier %s %s not off", p->name, k->name);
+    }
+    else {
+      CHECK(!(k->flags & SCH_OFF), "tier %s %s off", p->name, k->name);
+      CHECK(k->period == want[i].period, "tier %s %s period %u want %u", p->name, k->name, k->period,
+        want[i].period);
+      CHECK((k->flags & ~SCH_OFF) == want[i].flags, "tier %s %s flags %x want %x", p->name, k->name, k->flags,
+        want[i].flags);
+      CHECK(k->next >= t && (k->next % k->period) == k->offset && (k->next - t) <= k->period,
+        "tier %s %s next %u is not the next boundary after %u", p->name, k->name, k->next, t);
+    }
+  }
+  CHECK(distance_samples == p->gauge_samples, "tier %s gauge samples %u", p->name, distance_samples);
+}
+
+/*
+ * ======================================================================================================================
+ * Period() - Period and offset a task had in a tier
+ * ======================================================================================================================
+ */
+bool Period(const char *name, int tier, uint32_t *period, uint32_t *offset) {
+  PWR_TIER *p = &pwr_tiers[tier];
+
+  *offset = 0;
+  if (!strcmp(name, "GAUGE")) {
+    *period = p->gauge_period;
+  }
+  else if (!strcmp(name, "I2C")) {
+    *period = SCH_I2C_PERIOD;
+  }
+  else if (!strcmp(name, "OBS")) {
+    *period = p->obs_period;
+  }
+  else if (!strcmp(name, "DHCP")) {
+    *period = p->net_period;
+  }
+  else if (!strcmp(name, "N2S")) {
+    *period = p->net_period;
+    *offset = SCH_N2S_OFFSET;
+  }
+  else if (!strcmp(name, "NTP")) {
+    *period = p->net_period ? SCH_NTP_PERIOD : 0;
+    *offset = SCH_NTP_OFFSET;
+  }
+  else {
+    return (false);
+  }
+  return (true);
+}
+
+int main(int argc, char **argv) {
+  uint32_t boot = DateTime(2024, 3, 10, 10, 7, 23).unixtime();
+  uint32_t end = boot + 3 * 86400;
+  int changes = 0;
+  int tier = PWR_NORMAL;
+
+  verbose = (argc > 1) && !strcmp(argv[1], "-v");
+  host_us = (uint64_t) boot * 1000000;
+  SCH_Clock = VClock;
+  SCH_Sleep = VSleep;
+
+  PWR_Initialize();
+  SCH_Initialize();
+  CheckTier();
+
+  // One-shot OBS1 is in the table, due now, ahead of all periodic deadlines
+  CHECK(SCH_NextDeadline() == boot, "first deadline %u, not boot %u", SCH_NextDeadline(), boot);
+
+  int stuck = 0;
+  while (VClock() < end) {
+    uint32_t t = VClock();
+
+    // Battery down through every tier over the second day, then charged on the third
+    if (t < boot + 86400) {
+      volts = 4.0;
+    }
+    else if (t < boot + 2 * 86400) {
+      volts = 4.0 - 0.7 * (t - boot - 86400) / 86400.0;
+    }
+    else {
+      volts = 4.1;
+    }
+
+    SCH_Run();
+
+    // No sleep and nothing run, a deadline in the past that is never run
+    stuck = (VClock() == t) ? stuck + 1 : 0;
+    if (stuck > 100) {
+      printf ("FAIL clock stuck at %u\n", t);
+      return (1);
+    }
+
+    if (pwr_tier != tier) {
+      CHECK(abs(pwr_tier - tier) == 1 || pwr_tier > tier, "tier %d to %d skips on the way up", tier, pwr_tier);
+      tier = pwr_tier;
+      changes++;
+      CheckTier();
+    }
+  }
+
+  // OBS1 ran once, first, at boot, and is gone from the table
+  int obs1 = 0;
+  for (int i=0; i<nruns; i++) {
+    obs1 += !strcmp(runs[i].name, "OBS1");
+  }
+  CHECK(obs1 == 1, "OBS1 ran %d times", obs1);
+  CHECK(nruns && !strcmp(runs[0].name, "OBS1") && runs[0].t == boot, "first run %s at %u", runs[0].name,
+    runs[0].t);
+  for (int i=0; i<SCH_MAX_TASKS; i++) {
+    CHECK(!sch_tasks[i].inuse || strcmp(sch_tasks[i].name, "OBS1"), "OBS1 still in the table");
+  }
+
+  // Each periodic run is on its boundary, or late only because the task before it ran over or it waited for link.
+  // Tasks due at the same boundary run in table order.
+  const char *order[] = {"GAUGE", "I2C", "DHCP", "OBS", "N2S", "NTP"};
+  for (int i=1; i<nruns; i++) {
+    uint32_t period, offset;
+    if (!Period(runs[i].name, runs[i].tier, &period, &offset)) {
+      continue;
+    }
+    CHECK(period, "%s ran at %u in tier %d where it is off", runs[i].name, runs[i].t, runs[i].tier);
+    if (!period) {
+      continue;
+    }
+    uint32_t due = runs[i].t - ((runs[i].t + period - offset) % period);
+    if (due != runs[i].t) {
+      CHECK(runs[i-1].end > due || (runs[i].t - due) <= 2, "%s at %u is late for %u after %s at %u-%u",
+        runs[i].name, runs[i].t, due, runs[i-1].name, runs[i-1].t, runs[i-1].end);
+    }
+    int a = -1, b = -1;
+    for (int k=0; k<6; k++) {
+      a = strcmp(runs[i-1].name, order[k]) ? a : k;
+      b = strcmp(runs[i].name, order[k]) ? b : k;
+    }
+    uint32_t prev_period, prev_offset;
+    if ((a > b) && Period(runs[i-1].name, runs[i-1].tier, &prev_period, &prev_offset) && prev_period) {
+      uint32_t prev_due = runs[i-1].t - ((runs[i-1].t + prev_period - prev_offset) % prev_period);
+      CHECK(prev_due < due, "%s due %u ran before %s due %u", runs[i-1].name, prev_due, runs[i].name, due);
+    }
+  }
+
+  // Network tasks have the PHY. A quiet task only finds it up when it follows a task that woke it, with no sleep
+  // between, so quiet tasks never wake it.
+  for (int i=0; i<nruns; i++) {
+    bool net = !strcmp(runs[i].name, "DHCP") || !strcmp(runs[i].name, "N2S") || !strcmp(runs[i].name, "NTP") ||
+               (!strncmp(runs[i].name, "OBS", 3) && pwr_tiers[runs[i].tier].send == PWR_SEND_NOW);
+    CHECK(!net || runs[i].eth_awake, "%s at %u ran without the PHY", runs[i].name, runs[i].t);
+    if ((!strcmp(runs[i].name, "GAUGE") || !strcmp(runs[i].name, "I2C")) && runs[i].eth_awake) {
+      CHECK(i && (runs[i-1].sleep == runs[i].sleep) && runs[i-1].eth_awake, "%s at %u woke the PHY",
+        runs[i].name, runs[i].t);
+    }
+  }
+  CHECK(changes >= 6, "%d tier changes, the battery should take it down 3 tiers and back", changes);
+
+  printf ("sch_test: %d runs, %d sleeps, %d tier changes, %d failures\n", nruns, sleeps, changes, failures);
+  return (failures ? 1 : 0);
+}
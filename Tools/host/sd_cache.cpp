@@ -0,0 +1,97 @@
+/*
+ * ======================================================================================================================
+ *  sd_cache.cpp - Card commands of open, append and close cycles, for sizing the SdVolume block cache
+ *
+ *  A 90 byte record is appended to each of three files in turn, the daily log and profile in the month directory
+ *  and the N2S file in the root, each opened by path and closed again. Opening walks the directories, appending
+ *  reads the FAT when the file grows a cluster and closing writes the directory entry, so the FAT, directory and
+ *  data blocks compete for the cache on every cycle.
+ *
+ *    sd_cache card.img [cycles]        # card from fatimg.py mkfs, cycles (default 900)
+ *
+ *  Only the SD API the library has had from the start is used, so run.sh builds it against the library before
+ *  the LRU cache too. Each file's content is checked at the end.
+ * ======================================================================================================================
+ */
+#include <SD.h>
+#include "sdemu.h"
+
+#define CS_PIN  4
+#define REC_LEN 90
+
+const char *paths[] = {"/OBS/2026/01/20260101.OBS", "/OBS/2026/01/20260101.PRF", "/N2SOBS.DAT"};
+#define FILES (sizeof(paths) / sizeof(paths[0]))
+
+/*
+ * ======================================================================================================================
+ * Record() - The record of cycle n
+ * ======================================================================================================================
+ */
+void Record(int n, uint8_t *rec) {
+  for (int i=0; i<REC_LEN; i++) {
+    rec[i] = (uint8_t) (n * 13 + i);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Check() - Read each file back against the records of its cycles
+ * ======================================================================================================================
+ */
+bool Check(int cycles) {
+  uint8_t rec[REC_LEN], buf[REC_LEN];
+
+  for (unsigned f=0; f<FILES; f++) {
+    File fp = SD.open(paths[f], FILE_READ);
+
+    if (!fp || (fp.size() != (uint32_t) ((cycles - f + FILES - 1) / FILES) * REC_LEN)) {
+      printf ("%s: wrong size\n", paths[f]);
+      return (false);
+    }
+    for (int n=f; n<cycles; n+=FILES) {
+      Record(n, rec);
+      if ((fp.read(buf, REC_LEN) != REC_LEN) || memcmp(buf, rec, REC_LEN)) {
+        printf ("%s: record %d differs\n", paths[f], n);
+        return (false);
+      }
+    }
+    fp.close();
+  }
+  return (true);
+}
+
+int main(int argc, char **argv) {
+  int cycles = (argc > 2) ? atoi(argv[2]) : 900;
+  uint8_t rec[REC_LEN];
+  char label[32];
+
+  if ((argc < 2) || !SDEMU_Open(argv[1], CS_PIN)) {
+    printf ("usage: sd_cache card.img [cycles]\n");
+    return (1);
+  }
+  if (!SD.begin(CS_PIN) || !SD.mkdir("/OBS/2026/01")) {
+    printf ("SD.begin failed\n");
+    return (1);
+  }
+  SD.setClock(12000000);
+
+  SDEMU_Clear();
+  for (int n=0; n<cycles; n++) {
+    File fp = SD.open(paths[n % FILES], FILE_WRITE);
+
+    Record(n, rec);
+    if (!fp || (fp.write(rec, REC_LEN) != REC_LEN)) {
+      printf ("%s: append %d failed\n", paths[n % FILES], n);
+      return (1);
+    }
+    fp.close();
+  }
+  snprintf (label, sizeof(label), "%d cycles", cycles);
+  SDEMU_Print(label);
+
+  if (!Check(cycles)) {
+    return (1);
+  }
+  SDEMU_Close();
+  return (0);
+}
@@ -0,0 +1,100 @@
+/*
+ * ======================================================================================================================
+ *  sd_fatmap.cpp - Cluster allocation on a filling card, with and without the SdVolume free cluster map
+ *
+ *  The card is first filled to a share of its clusters from the start, as old logs leave it. Then each cycle is an
+ *  observation through SDC.h, appended to the daily log and to the N2S file, and a drain that removes the N2S
+ *  file. Removing it sends the next allocation search back to cluster 2, through every full FAT block unless the
+ *  map lets it skip them. run.sh builds this with SD_FAT_MAP_BYTES=0 and with the default and checks that both
+ *  leave the same files.
+ *
+ *    sd_fatmap card.img [cycles [MB]]  # card from fatimg.py mkfs, cycles (default 600), MB filled (default 38)
+ * ======================================================================================================================
+ */
+#include "station.h"
+
+#define OBS_PERIOD  900
+#define START       1767225600UL      // 2026-01-01 00:00:00
+#define FILL_MB     1                 // Size of each fill file
+
+uint8_t buf[16384];
+
+/*
+ * ======================================================================================================================
+ * Fill() - Write mb one MB files in /FILL
+ * ======================================================================================================================
+ */
+bool Fill(int mb) {
+  char path[24];
+
+  SD.mkdir("/FILL");
+  for (int f=0; f<mb / FILL_MB; f++) {
+    File fp;
+
+    sprintf (path, "/FILL/F%03d.DAT", f);
+    fp = SD.open(path, FILE_WRITE);
+    for (uint32_t pos=0; fp && (pos < FILL_MB * 1048576UL); pos+=sizeof(buf)) {
+      memset (buf, f, sizeof(buf));
+      if (fp.write(buf, sizeof(buf)) != sizeof(buf)) {
+        fp.close();
+      }
+    }
+    if (!fp) {
+      printf ("%s: write failed\n", path);
+      return (false);
+    }
+    fp.close();
+  }
+  return (true);
+}
+
+int main(int argc, char **argv) {
+  int cycles = (argc > 2) ? atoi(argv[2]) : 600;
+  int mb = (argc > 3) ? atoi(argv[3]) : 38;
+  uint8_t rec[48];
+
+  if ((argc < 2) || !SDEMU_Open(argv[1], SD_ChipSelect)) {
+    printf ("usage: sd_fatmap card.img [cycles [MB]]\n");
+    return (1);
+  }
+  Station_Clock(START);
+  SD_initialize();
+  if (!SD_exists) {
+    printf ("SD_initialize failed\n");
+    return (1);
+  }
+  SD.setClock(cf_spi_mhz * 1000000UL);
+  if (!Fill(mb)) {
+    return (1);
+  }
+
+  for (unsigned i=0; i<sizeof(rec); i++) {
+    rec[i] = i * 37;
+  }
+  rec[SD_REC_LEN] = sizeof(rec);
+  rec[SD_REC_SCHEMA] = 1;
+
+  uint32_t allocs = SD.allocCount();
+  uint32_t alloc_us = SD.allocMicros();
+  uint32_t fat_reads = SD.allocReads();
+  SDEMU_Clear();
+  for (int n=0; n<cycles; n++) {
+    Station_Clock(START + n * OBS_PERIOD);
+    rec[SD_REC_HDR] = n;
+    SD_LogRecord(rec);
+    SD_NeedToSend_Add(rec);
+    SD_Sync();
+    if (!SD_N2S_Delete()) {
+      printf ("N2S remove %d failed\n", n);
+      return (1);
+    }
+  }
+  SD_logfp.close();
+  allocs = SD.allocCount() - allocs;
+
+  printf ("SD_FAT_MAP_BYTES=%-4d %u allocations, %u FAT blocks read, %.0fus each\n", SD_FAT_MAP_BYTES, allocs,
+    SD.allocReads() - fat_reads, (double) (SD.allocMicros() - alloc_us) / allocs);
+  SDEMU_Print("");
+  SDEMU_Close();
+  return (0);
+}
@@ -0,0 +1,142 @@
+/*
+ * ======================================================================================================================
+ *  sd_layout.cpp - Migration of flat /OBS daily files to /OBS/YYYY/MM, and the card commands of an open in each layout
+ *
+ *  Daily .LOG and .PRF files are made flat in /OBS as an older station left them, then SD_Migrate() from SDC.h
+ *  moves them. Every file must be at its new path with the same content, none left in /OBS and the LAYOUT.YM
+ *  marker made. Opening the newest file is counted flat by path, by path in the new layout, and in the month
+ *  directory SD_ObsDir() keeps open.
+ *
+ *    sd_layout card.img [days]         # card from fatimg.py mkfs, days of files (default 48, two files a day)
+ * ======================================================================================================================
+ */
+#include "station.h"
+
+#define DAY         86400UL
+#define START       1764547200UL      // 2025-12-01 00:00:00
+
+const char *kinds[] = {"LOG", "PRF"};
+
+/*
+ * ======================================================================================================================
+ * Fill() - Content of the file of day d and kind k, a different size and pattern for each
+ * ======================================================================================================================
+ */
+uint32_t Fill(int d, int k, uint8_t *buf) {
+  uint32_t size = 200 + ((d * 131 + k * 977) % 1500);
+
+  for (uint32_t i=0; i<size; i++) {
+    buf[i] = (uint8_t) (d * 7 + k * 3 + i);
+  }
+  return (size);
+}
+
+/*
+ * ======================================================================================================================
+ * Name() - Path of the file of day d and kind k, flat in /OBS or in its month directory
+ * ======================================================================================================================
+ */
+void Name(int d, int k, bool flat, char *path) {
+  DateTime t(START + d * DAY);
+
+  if (flat) {
+    sprintf (path, "%s/%4d%02d%02d.%s", SD_obsdir, t.year(), t.month(), t.day(), kinds[k]);
+  }
+  else {
+    sprintf (path, "%s/%4d/%02d/%4d%02d%02d.%s", SD_obsdir, t.year(), t.month(), t.year(), t.month(), t.day(),
+      kinds[k]);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Open() - Open path or name in dir, print the card commands it took
+ * ======================================================================================================================
+ */
+void Open(const char *label, File *dir, const char *path) {
+  File fp;
+
+  SDEMU_Clear();
+  fp = dir ? SD.open(*dir, path, FILE_READ) : SD.open(path, FILE_READ);
+  printf ("%-28s %s %u cmds, %u blocks read\n", label, fp ? "" : "FAIL", sdemu.cmds, sdemu.blocks_read);
+  if (fp) {
+    fp.close();
+  }
+}
+
+int main(int argc, char **argv) {
+  int days = (argc > 2) ? atoi(argv[2]) : 48;
+  uint8_t buf[2048], data[2048];
+  char path[40];
+  int failures = 0;
+
+  if ((argc < 2) || !SDEMU_Open(argv[1], SD_ChipSelect)) {
+    printf ("usage: sd_layout card.img [days]\n");
+    return (1);
+  }
+  if (!SD.begin(SD_ChipSelect) || !SD.mkdir(SD_obsdir)) {
+    printf ("SD.begin failed\n");
+    return (1);
+  }
+  SD.setClock(cf_spi_mhz * 1000000UL);
+  SD_exists = true;
+
+  for (int d=0; d<days; d++) {
+    for (int k=0; k<2; k++) {
+      uint32_t size = Fill(d, k, buf);
+      File fp;
+
+      Name(d, k, true, path);
+      fp = SD.open(path, FILE_WRITE);
+      if (!fp || (fp.write(buf, size) != size)) {
+        printf ("%s: write failed\n", path);
+        return (1);
+      }
+      fp.close();
+    }
+  }
+  Name(days - 1, 0, true, path);
+  Open("open flat by path", NULL, path);
+
+  station_verbose = true;
+  SD_Migrate();
+  station_verbose = false;
+
+  for (int d=0; d<days; d++) {
+    for (int k=0; k<2; k++) {
+      uint32_t size = Fill(d, k, buf);
+      File fp;
+
+      Name(d, k, true, path);
+      if (SD.exists(path)) {
+        printf ("FAIL %s left behind\n", path);
+        failures++;
+      }
+      Name(d, k, false, path);
+      fp = SD.open(path, FILE_READ);
+      if (!fp || (fp.size() != size) || (fp.read(data, size) != (int) size) || memcmp(data, buf, size)) {
+        printf ("FAIL %s missing or differs\n", path);
+        failures++;
+      }
+      if (fp) {
+        fp.close();
+      }
+    }
+  }
+  sprintf (path, "%s/%s", SD_obsdir, SD_LAYOUT_MARKER);
+  if (!SD.exists(path)) {
+    printf ("FAIL no %s\n", path);
+    failures++;
+  }
+
+  DateTime last(START + (days - 1) * DAY);
+  Name(days - 1, 0, false, path);
+  Open("open by path", NULL, path);
+  SD_ObsDir(last.year(), last.month());
+  Open("open in the month directory", &SD_monthdir, strrchr(path, '/') + 1);
+
+  SD_monthdir.close();
+  SDEMU_Close();
+  printf ("sd_layout: %d files, %d failures\n", days * 2, failures);
+  return (failures != 0);
+}
@@ -0,0 +1,131 @@
+/*
+ * ======================================================================================================================
+ *  sd_multi.cpp - Sequential SD throughput, single block against CMD18/CMD25 multi-block transfers
+ *
+ *  A file is written and read back through the SD library on the emulated card, in 512 byte pieces and in bigger
+ *  ones. SdFile::read() and write() only use multi-block commands when a piece covers two or more whole blocks of
+ *  a cluster, so 512 byte pieces go a block per command as before. The content read back is checked each time.
+ *
+ *    sd_multi card.img [KB]            # card from fatimg.py mkfs, KB written per run (default 2048)
+ *
+ *  Throughput is of the bus time on the emulator, see sdemu.cpp for the card times it uses.
+ * ======================================================================================================================
+ */
+#include <SD.h>
+#include "sdemu.h"
+
+#define CS_PIN  4
+
+uint8_t buf[16384];                 // SdFile::read() returns int16_t, a piece must stay under 32KB
+
+/*
+ * ======================================================================================================================
+ * Fill() - Pattern of the byte at file offset pos
+ * ======================================================================================================================
+ */
+uint8_t Fill(uint32_t pos) {
+  return (uint8_t) ((pos * 7) ^ (pos >> 9));
+}
+
+/*
+ * ======================================================================================================================
+ * Report() - Counts and throughput of a run
+ * ======================================================================================================================
+ */
+void Report(const char *label, uint32_t bytes, uint64_t start_us) {
+  uint64_t us = host_us - start_us;
+
+  SDEMU_Print(label);
+  printf ("%-28s %u KB in %.1fms, %.0f KB/s\n", "", bytes / 1024, us / 1000.0, (bytes / 1024.0) / (us / 1e6));
+}
+
+/*
+ * ======================================================================================================================
+ * Write() - Write the file in pieces of n bytes
+ * ======================================================================================================================
+ */
+bool Write(const char *name, uint32_t size, int n) {
+  char label[40];
+  uint64_t start;
+  File fp;
+
+  SD.remove(name);
+  SDEMU_Clear();
+  start = host_us;
+  fp = SD.open(name, FILE_WRITE);
+  if (!fp) {
+    printf ("open %s failed\n", name);
+    return (false);
+  }
+  for (uint32_t pos=0; pos<size; pos+=n) {
+    for (int i=0; i<n; i++) {
+      buf[i] = Fill(pos + i);
+    }
+    if (fp.write(buf, n) != (size_t) n) {
+      printf ("write %s at %u failed\n", name, pos);
+      return (false);
+    }
+  }
+  fp.close();
+  snprintf (label, sizeof(label), "write %5d byte pieces", n);
+  Report(label, size, start);
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * Read() - Read the file back in pieces of n bytes and check it
+ * ======================================================================================================================
+ */
+bool Read(const char *name, uint32_t size, int n) {
+  char label[40];
+  uint64_t start;
+  File fp;
+
+  SDEMU_Clear();
+  start = host_us;
+  fp = SD.open(name, FILE_READ);
+  if (!fp || (fp.size() != size)) {
+    printf ("open %s failed\n", name);
+    return (false);
+  }
+  for (uint32_t pos=0; pos<size; pos+=n) {
+    if (fp.read(buf, n) != n) {
+      printf ("read %s at %u failed\n", name, pos);
+      return (false);
+    }
+    for (int i=0; i<n; i++) {
+      if (buf[i] != Fill(pos + i)) {
+        printf ("read %s differs at %u\n", name, pos + i);
+        return (false);
+      }
+    }
+  }
+  fp.close();
+  snprintf (label, sizeof(label), "read  %5d byte pieces", n);
+  Report(label, size, start);
+  return (true);
+}
+
+int main(int argc, char **argv) {
+  uint32_t size = ((argc > 2) ? atoi(argv[2]) : 2048) * 1024;
+  const int pieces[] = {512, 4096, 16384};
+
+  if ((argc < 2) || !SDEMU_Open(argv[1], CS_PIN)) {
+    printf ("usage: sd_multi card.img [KB]\n");
+    return (1);
+  }
+  if (!SD.begin(CS_PIN)) {
+    printf ("SD.begin failed\n");
+    return (1);
+  }
+  SD.setClock(12000000);
+
+  for (int i=0; i<3; i++) {
+    if (!Write("SEQ.DAT", size, pieces[i]) || !Read("SEQ.DAT", size, pieces[i])) {
+      return (1);
+    }
+  }
+  SDEMU_Close();
+  return (0);
+}
@@ -0,0 +1,152 @@
+/*
+ * ======================================================================================================================
+ *  sd_obs.cpp - Card blocks read and written per observation, by how the log and N2S records are written
+ *
+ *  Two days of 15 minute observations are appended to the daily log and the N2S file, with a sleep after each
+ *  one as SCH_RTC_Sleep() does. Each way of writing them runs on its own days of the same card:
+ *
+ *    open/write/close    Both files opened by path for each record and closed, as the station first did
+ *    open, unbuffered    Files kept open, each frame written as it is and flushed before sleep
+ *    sd_sync=N           SD_LogRecord() and SD_NeedToSend_Add() through the SDC.h append buffers, SD_Sync()
+ *                        before sleep when sd_sync=0
+ *
+ *    sd_obs card.img [bytes]           # card from fatimg.py mkfs, observation record bytes (default 48)
+ *
+ *  The counts are the card's, from the emulator, divided by the observations.
+ * ======================================================================================================================
+ */
+#include "station.h"
+
+#define DAY         86400UL
+#define OBS_PERIOD  900
+#define OBS_DAYS    2
+#define START       1767225600UL      // 2026-01-01 00:00:00
+
+typedef enum {OPEN_CLOSE, UNBUFFERED, BUFFERED} MODE;
+
+uint8_t rec[SD_REC_MAX];
+File log_fp, n2s_fp;                  // Open files of the unbuffered mode
+char log_path[32];
+
+/*
+ * ======================================================================================================================
+ * Frame() - Write rec in its frame straight to fp
+ * ======================================================================================================================
+ */
+void Frame(File &fp) {
+  uint8_t sync = SD_REC_SYNC;
+  uint32_t crc = crc32(0, rec, rec[SD_REC_LEN]);
+
+  fp.write(&sync, 1);
+  fp.write(rec, rec[SD_REC_LEN]);
+  fp.write((uint8_t *) &crc, 4);
+}
+
+/*
+ * ======================================================================================================================
+ * Observe() - Log and N2S one observation, then sleep
+ * ======================================================================================================================
+ */
+void Observe(MODE mode) {
+  char path[32];
+
+  sprintf (path, "%s/%4d/%02d/%4d%02d%02d.obs", SD_obsdir, now.year(), now.month(), now.year(), now.month(),
+    now.day());
+
+  if (mode == BUFFERED) {
+    SD_LogRecord(rec);
+    SD_NeedToSend_Add(rec);
+    if (!cf_sd_sync) {
+      SD_Sync();
+    }
+    return;
+  }
+
+  SD_ObsDir(now.year(), now.month());
+  if (mode == OPEN_CLOSE) {
+    log_fp = SD.open(path, FILE_WRITE);
+    Frame(log_fp);
+    log_fp.close();
+    n2s_fp = SD.open(SD_n2s_file, FILE_WRITE);
+    Frame(n2s_fp);
+    n2s_fp.close();
+  }
+  else {
+    if (log_fp && strcmp(path, log_path)) {
+      log_fp.close();
+    }
+    if (!log_fp) {
+      log_fp = SD.open(path, FILE_WRITE);
+      strcpy (log_path, path);
+    }
+    if (!n2s_fp) {
+      n2s_fp = SD.open(SD_n2s_file, FILE_WRITE);
+    }
+    Frame(log_fp);
+    Frame(n2s_fp);
+    log_fp.flush();
+    n2s_fp.flush();
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Run() - Observe for OBS_DAYS from day, and report the card's counts per observation
+ * ======================================================================================================================
+ */
+void Run(const char *label, MODE mode, int sd_sync, uint32_t day) {
+  int n = 0;
+
+  SD_N2S_Delete();
+  cf_sd_sync = sd_sync;
+  SDEMU_Clear();
+  for (uint32_t t=day; t<day + OBS_DAYS * DAY; t+=OBS_PERIOD, n++) {
+    Station_Clock(t);
+    rec[SD_REC_HDR] = n;
+    Observe(mode);
+  }
+  if (log_fp) {
+    log_fp.close();
+  }
+  if (n2s_fp) {
+    n2s_fp.close();
+  }
+  printf ("%-20s blocks R %5.2f W %5.2f  cmds %5.2f  bus %6.2fms per observation\n", label,
+    (double) sdemu.blocks_read / n, (double) sdemu.blocks_written / n, (double) sdemu.cmds / n,
+    sdemu.bus_ns / 1e6 / n);
+}
+
+int main(int argc, char **argv) {
+  int bytes = (argc > 2) ? atoi(argv[2]) : 48;
+
+  if ((argc < 2) || (bytes < SD_REC_HDR + 1) || (bytes > SD_REC_MAX) || !SDEMU_Open(argv[1], SD_ChipSelect)) {
+    printf ("usage: sd_obs card.img [bytes]\n");
+    return (1);
+  }
+  Station_Clock(START);
+  SD_initialize();
+  if (!SD_exists) {
+    printf ("SD_initialize failed\n");
+    return (1);
+  }
+  SD.setClock(cf_spi_mhz * 1000000UL);
+
+  for (int i=0; i<bytes; i++) {
+    rec[i] = i * 37;
+  }
+  rec[SD_REC_LEN] = bytes;
+  rec[SD_REC_SCHEMA] = 1;
+
+  printf ("%d byte records, %d observations a day\n", bytes, (int) (DAY / OBS_PERIOD));
+  Run("open/write/close", OPEN_CLOSE, 0, START);
+  Run("open, unbuffered", UNBUFFERED, 0, START + 2 * DAY);
+  Run("sd_sync=1", BUFFERED, 1, START + 4 * DAY);
+  Run("sd_sync=4 default", BUFFERED, 4, START + 6 * DAY);
+  Run("sd_sync=0", BUFFERED, 0, START + 8 * DAY);
+
+  SD_Sync();
+  SD_logfp.close();
+  SD_N2S_Close();
+  SDEMU_Close();
+  return (0);
+}
@@ -0,0 +1,444 @@
+/*
+ * ======================================================================================================================
+ *  sdemu.cpp - SD card on the host SPI bus, backed by an image file
+ *
+ *  Takes the place of the SPI library and answers the SD SPI mode protocol as an SDHC card: CMD0, 8, 9, 10, 12,
+ *  13, 16, 17, 18, 24, 25, 32, 33, 38, 55, 58 and ACMD23, 41. The SD library's own Sd2Card.cpp runs against it,
+ *  so the commands counted here are the ones a card would see. Blocks are read from and written to the image file
+ *  as they are transferred.
+ *
+ *  Each byte moves host_us on by its time at the clock given to beginTransaction(), at most 12MHz as on the
+ *  SAMD21. The card adds the access and programming times below. It sends 0xFF until a read block is ready and
+ *  holds MISO low while it programs a write. The times are typical of a class 10 card, set them from a card's
+ *  datasheet or a logic analyser trace to compare with a station. Only the bus is timed, not the CPU.
+ * ======================================================================================================================
+ */
+#include <SPI.h>
+#include "sdemu.h"
+
+#define SDEMU_MAX_HZ        12000000  // SAMD21 SERCOM SPI limit at 48MHz
+#define SDEMU_READ_US       300       // CMD17 and the first CMD18 block, access time
+#define SDEMU_READ_NEXT_US  40        // Each further CMD18 block
+#define SDEMU_WRITE_US      900       // Programming a CMD24 block
+#define SDEMU_ERASED_US     150       // Programming a CMD25 block pre-erased by ACMD23
+#define SDEMU_NEXT_US       400       // Programming a CMD25 block past the pre-erase count
+#define SDEMU_STOP_US       300       // Busy after the CMD25 stop token
+#define SDEMU_CMD12_US      50        // Busy after CMD12
+#define SDEMU_ERASE_US      2000      // CMD38
+
+#define DATA_START_BLOCK    0xFE
+#define WRITE_MULTIPLE      0xFC
+#define STOP_TRAN           0xFD
+#define DATA_ACCEPTED       0x05
+
+SDEMU_STATS sdemu;
+SPIClass SPI;
+
+static FILE *img = NULL;
+static uint32_t nblocks = 0;
+static uint8_t cs = 0xFF;           // Chip select pin
+static bool selected = false;
+static uint32_t hz = 250000;
+static uint32_t frac_ns = 0;        // Time under a microsecond not yet added to host_us
+
+static uint8_t cmd[6];              // Command being received
+static int cmdn = 0;
+static bool idle = true;            // Until ACMD41
+static bool app = false;            // Last command was CMD55
+
+static uint8_t q[520];              // Bytes the card sends next
+static int qh = 0, qt = 0;
+
+enum {S_IDLE, S_READ, S_WRITE};
+static int state = S_IDLE;
+static bool multi = false;
+static uint32_t block = 0;          // Next block to read or write
+static uint64_t ready_ns = 0;       // Read block ready, 0 = timed from when the last one has been sent
+static uint64_t busy_ns = 0;        // Programming until
+static int wpos = -1;               // Write bytes received, -1 waiting for the token
+static uint8_t wbuf[512];
+static uint32_t erase_count = 0;    // ACMD23 pre-erase blocks left
+static uint32_t erase_start = 0, erase_end = 0;
+
+/*
+ * ======================================================================================================================
+ * Now() - Virtual time in ns
+ * ======================================================================================================================
+ */
+static uint64_t Now() {
+  return host_us * 1000 + frac_ns;
+}
+
+/*
+ * ======================================================================================================================
+ * Push() - Queue a byte for the card to send
+ * ======================================================================================================================
+ */
+static void Push(uint8_t b) {
+  if (qt < (int) sizeof(q)) {
+    q[qt++] = b;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Block() - Read or write one block of the image
+ * ======================================================================================================================
+ */
+static void Block(uint32_t n, uint8_t *buf, bool write) {
+  fseek (img, (long) n * 512, SEEK_SET);
+  if (write) {
+    fwrite (buf, 1, 512, img);
+  }
+  else if (fread (buf, 1, 512, img) != 512) {
+    memset (buf, 0, 512);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Command() - Act on a received command and queue its response
+ * ======================================================================================================================
+ */
+static void Command() {
+  uint8_t index = cmd[0] & 0x3F;
+  uint32_t arg = ((uint32_t) cmd[1] << 24) | ((uint32_t) cmd[2] << 16) | (cmd[3] << 8) | cmd[4];
+  uint8_t r1 = idle ? 0x01 : 0x00;
+  uint8_t reg[16] = {0};
+
+  sdemu.cmds++;
+  qh = qt = 0;                      // CMD12 ends a read in the middle of a block
+  Push(0xFF);                       // NCR
+
+  if (app) {
+    app = false;
+    if (index == 41) {
+      idle = false;
+      Push(0x00);
+    }
+    else if (index == 23) {
+      erase_count = arg;
+      Push(r1);
+    }
+    else {
+      Push(r1 | 0x04);
+    }
+    return;
+  }
+
+  switch (index) {
+    case 0:
+      idle = true;
+      state = S_IDLE;
+      Push(0x01);
+      break;
+    case 8:
+      Push(r1);
+      Push(0x00);
+      Push(0x00);
+      Push(0x01);
+      Push(arg & 0xFF);
+      break;
+    case 9:
+    case 10:
+      if (index == 9) {
+        uint32_t c_size = nblocks / 1024 - 1;
+        uint8_t csd[16] = {0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00, (uint8_t) ((c_size >> 16) & 0x3F),
+                           (uint8_t) (c_size >> 8), (uint8_t) c_size, 0x7F, 0x80, 0x0A, 0x40, 0x00, 0x01};
+        memcpy (reg, csd, 16);
+      }
+      Push(r1);
+      Push(0xFF);
+      Push(DATA_START_BLOCK);
+      for (int i=0; i<16; i++) {
+        Push(reg[i]);
+      }
+      Push(0xFF);
+      Push(0xFF);
+      break;
+    case 12:
+      state = S_IDLE;
+      Push(0xFF);                   // Stuff byte
+      Push(r1);
+      busy_ns = Now() + SDEMU_CMD12_US * 1000;
+      break;
+    case 13:
+      Push(r1);
+      Push(0x00);
+      break;
+    case 17:
+    case 18:
+      if (arg >= nblocks) {
+        Push(r1 | 0x40);
+        break;
+      }
+      Push(r1);
+      state = S_READ;
+      multi = (index == 18);
+      block = arg;
+      ready_ns = Now() + SDEMU_READ_US * 1000;
+      if (multi) {
+        sdemu.cmd18++;
+      }
+      else {
+        sdemu.cmd17++;
+      }
+      break;
+    case 24:
+    case 25:
+      if ((arg == 0) || (arg >= nblocks)) {
+        Push(r1 | 0x40);
+        break;
+      }
+      Push(r1);
+      state = S_WRITE;
+      multi = (index == 25);
+      block = arg;
+      wpos = -1;
+      if (multi) {
+        sdemu.cmd25++;
+      }
+      else {
+        sdemu.cmd24++;
+        erase_count = 0;
+      }
+      break;
+    case 32:
+      erase_start = arg;
+      Push(r1);
+      break;
+    case 33:
+      erase_end = arg;
+      Push(r1);
+      break;
+    case 38:
+      memset (wbuf, 0, sizeof(wbuf));
+      for (uint32_t n=erase_start; (n<=erase_end) && (n<nblocks); n++) {
+        Block(n, wbuf, true);
+      }
+      Push(r1);
+      busy_ns = Now() + SDEMU_ERASE_US * 1000;
+      break;
+    case 16:
+      Push(r1);
+      break;
+    case 55:
+      app = true;
+      Push(r1);
+      break;
+    case 58:
+      Push(r1);
+      Push(0xC0);                   // Powered up, SDHC
+      Push(0xFF);
+      Push(0x80);
+      Push(0x00);
+      break;
+    default:
+      Push(r1 | 0x04);              // Illegal command
+      break;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Out() - The byte the card sends
+ * ======================================================================================================================
+ */
+static uint8_t Out() {
+  if (qh < qt) {
+    return (q[qh++]);
+  }
+  qh = qt = 0;
+
+  if (state == S_READ) {
+    if (ready_ns == 0) {
+      ready_ns = Now() + SDEMU_READ_NEXT_US * 1000;
+    }
+    if ((Now() < ready_ns) || (block >= nblocks)) {
+      return (0xFF);
+    }
+    Push(DATA_START_BLOCK);
+    Block(block++, q + qt, false);
+    qt += 512;
+    Push(0xFF);
+    Push(0xFF);
+    sdemu.blocks_read++;
+    ready_ns = 0;
+    if (!multi) {
+      state = S_IDLE;
+    }
+    return (q[qh++]);
+  }
+
+  return ((Now() < busy_ns) ? 0x00 : 0xFF);
+}
+
+/*
+ * ======================================================================================================================
+ * In() - Take the byte the host sends
+ * ======================================================================================================================
+ */
+static void In(uint8_t b) {
+  if (cmdn) {
+    cmd[cmdn++] = b;
+    if (cmdn == 6) {
+      cmdn = 0;
+      Command();
+    }
+    return;
+  }
+
+  if (state == S_WRITE) {
+    if (wpos < 0) {
+      if (b == (multi ? WRITE_MULTIPLE : DATA_START_BLOCK)) {
+        wpos = 0;
+      }
+      else if (multi && (b == STOP_TRAN)) {
+        state = S_IDLE;
+        erase_count = 0;
+        busy_ns = Now() + SDEMU_STOP_US * 1000;
+      }
+      return;
+    }
+    if (wpos < 512) {
+      wbuf[wpos] = b;
+    }
+    if (++wpos == 514) {            // Data and CRC
+      Block(block++, wbuf, true);
+      sdemu.blocks_written++;
+      Push(DATA_ACCEPTED);
+      if (!multi) {
+        busy_ns = Now() + SDEMU_WRITE_US * 1000;
+        state = S_IDLE;
+      }
+      else if (erase_count) {
+        busy_ns = Now() + SDEMU_ERASED_US * 1000;
+        erase_count--;
+      }
+      else {
+        busy_ns = Now() + SDEMU_NEXT_US * 1000;
+      }
+      wpos = -1;
+    }
+    return;
+  }
+
+  if ((b & 0xC0) == 0x40) {
+    cmd[0] = b;
+    cmdn = 1;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Byte() - Clock one byte each way
+ * ======================================================================================================================
+ */
+static uint8_t Byte(uint8_t b) {
+  uint32_t ns = 8000000000ULL / hz;
+  uint8_t out = 0xFF;
+
+  frac_ns += ns;
+  host_us += frac_ns / 1000;
+  frac_ns %= 1000;
+
+  if (img && selected) {
+    sdemu.bytes++;
+    sdemu.bus_ns += ns;
+    out = Out();
+    In(b);
+  }
+  return (out);
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+  hz = (settings.clock < SDEMU_MAX_HZ) ? settings.clock : SDEMU_MAX_HZ;
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  return (Byte(data));
+}
+
+void SPIClass::transfer(void *buf, size_t count) {
+  uint8_t *p = (uint8_t *) buf;
+
+  for (size_t i=0; i<count; i++) {
+    p[i] = Byte(p[i]);
+  }
+}
+
+void SPIClass::transfer(const void *txbuf, void *rxbuf, size_t count, bool block) {
+  const uint8_t *tx = (const uint8_t *) txbuf;
+  uint8_t *rx = (uint8_t *) rxbuf;
+
+  for (size_t i=0; i<count; i++) {
+    uint8_t b = Byte(tx ? tx[i] : 0xFF);
+    if (rx) {
+      rx[i] = b;
+    }
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * Pin() - Chip select
+ * ======================================================================================================================
+ */
+static void Pin(uint8_t pin, uint8_t val) {
+  if (pin == cs) {
+    selected = (val == LOW);
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * SDEMU_Open() - Insert the card, image is a whole card with its partition table, see fatimg.py
+ * ======================================================================================================================
+ */
+bool SDEMU_Open(const char *image, uint8_t cs_pin) {
+  img = fopen(image, "r+b");
+  if (!img) {
+    perror (image);
+    return (false);
+  }
+  fseek (img, 0, SEEK_END);
+  nblocks = ftell(img) / 512;
+  cs = cs_pin;
+  host_pin_hook = Pin;
+  idle = true;
+  state = S_IDLE;
+  SDEMU_Clear();
+  return (true);
+}
+
+/*
+ * ======================================================================================================================
+ * SDEMU_Close() - Remove the card, the image has all that was written
+ * ======================================================================================================================
+ */
+void SDEMU_Close() {
+  if (img) {
+    fclose (img);
+    img = NULL;
+  }
+}
+
+/*
+ * ======================================================================================================================
+ * SDEMU_Clear() - Zero the counts
+ * ======================================================================================================================
+ */
+void SDEMU_Clear() {
+  memset (&sdemu, 0, sizeof(sdemu));
+}
+
+/*
+ * ======================================================================================================================
+ * SDEMU_Print() - Output the counts
+ * ======================================================================================================================
+ */
+void SDEMU_Print(const char *label) {
+  printf ("%-28s cmds %6u  CMD17 %6u CMD18 %5u CMD24 %6u CMD25 %5u  blocks R %6u W %6u  bus %8.1fms\n", label,
+    sdemu.cmds, sdemu.cmd17, sdemu.cmd18, sdemu.cmd24, sdemu.cmd25, sdemu.blocks_read, sdemu.blocks_written,
+    sdemu.bus_ns / 1e6);
+}
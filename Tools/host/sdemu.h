@@ -0,0 +1,30 @@
+/*
+ * ======================================================================================================================
+ *  sdemu.h - SD card on the host SPI bus, backed by an image file, see sdemu.cpp
+ * ======================================================================================================================
+ */
+#ifndef sdemu_h
+#define sdemu_h
+
+#include <Arduino.h>
+
+typedef struct {
+  uint32_t  cmds;                   // Commands, an ACMD counts once
+  uint32_t  cmd17;                  // READ_SINGLE_BLOCK
+  uint32_t  cmd18;                  // READ_MULTIPLE_BLOCK
+  uint32_t  cmd24;                  // WRITE_BLOCK
+  uint32_t  cmd25;                  // WRITE_MULTIPLE_BLOCK
+  uint32_t  blocks_read;
+  uint32_t  blocks_written;
+  uint64_t  bytes;                  // Bytes clocked with the card selected
+  uint64_t  bus_ns;                 // Time the card was selected
+} SDEMU_STATS;
+
+extern SDEMU_STATS sdemu;
+
+bool SDEMU_Open(const char *image, uint8_t cs_pin);
+void SDEMU_Close();
+void SDEMU_Clear();
+void SDEMU_Print(const char *label);
+
+#endif  // sdemu_h
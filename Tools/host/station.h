@@ -0,0 +1,66 @@
+/*
+ * ======================================================================================================================
+ *  station.h - SDC.h from the sketch with the station globals it uses, for the SD harnesses
+ *
+ *  SF.h, CF.h and SDC.h are included as they are, the rest of the station is stubbed here as it is declared in
+ *  SSG-Eth-ULP.ino and TM.h. Output() is quiet unless station_verbose is set. The card is the emulator, opened by
+ *  the harness before SD_initialize(). A harness that includes OBS.h defines STATION_OBS first, it has the real
+ *  OBS_Export().
+ * ======================================================================================================================
+ */
+#ifndef station_h
+#define station_h
+
+#include <SPI.h>
+#include <Wire.h>
+#include <SD.h>
+#include <RTClib.h>
+#include "sdemu.h"
+
+#define SSB_PWRON           0x1
+#define SSB_SD              0x2
+#define SSB_OLED            0x8
+#define SSB_N2S             0x10
+#define SSB_FROM_N2S        0x20
+#define SSB_BMX_1           0x80
+#define SSB_BMX_2           0x100
+#define SSB_MCP_1           0x800
+#define SSB_DS_1            0x2000
+#define LED_PIN             LED_BUILTIN
+
+char msgbuf[1024];
+unsigned int SystemStatusBits = SSB_PWRON;
+bool JustPoweredOn = true;
+bool FastBoot = true;
+bool RTC_valid = true;
+DateTime now;
+bool station_verbose = false;
+
+void Output(const char *str) {
+  if (station_verbose) {
+    printf ("%s\n", str);
+  }
+}
+
+void NVM_Save(uint32_t file_size, uint32_t file_crc) {}
+bool NVM_Load() { return (false); }
+
+#include "SF.h"
+#include "CF.h"
+#include "SDC.h"
+
+#ifndef STATION_OBS
+void OBS_Export(const char *path) {}
+#endif
+
+/*
+ * ======================================================================================================================
+ * Station_Clock() - Set the virtual clock and now to t, seconds since 1970
+ * ======================================================================================================================
+ */
+void Station_Clock(uint32_t t) {
+  host_us = (uint64_t) t * 1000000;
+  now = DateTime(t);
+}
+
+#endif  // station_h
@@ -0,0 +1,91 @@
+/*
+ * ======================================================================================================================
+ *  Arduino.h - Host stand-in for the Arduino core
+ *
+ *  Just enough of the core to build the SD library and headers of the sketch with g++ on a Linux host. Time is
+ *  virtual, host_us is microseconds since 1970 and only moves when a harness, delay() or the card emulator moves it.
+ *  millis() and micros() are read from it, and so is the RTC in RTClib.h.
+ * ======================================================================================================================
+ */
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH          0x1
+#define LOW           0x0
+#define INPUT         0x0
+#define OUTPUT        0x1
+#define INPUT_PULLUP  0x2
+
+#define LED_BUILTIN   13
+#define SS            4
+#define MOSI          23
+#define MISO          22
+#define SCK           24
+#define A7            9
+
+#define MSBFIRST      1
+#define SPI_MODE0     0
+
+#define DEC           10
+#define HEX           16
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+extern uint64_t host_us;            // Virtual time, microseconds since 1970
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+// Pin writes are passed here, the card emulator watches its chip select
+extern void (*host_pin_hook)(uint8_t pin, uint8_t val);
+
+#include "Print.h"
+
+class String {
+  public:
+    String(const char *s = "") { snprintf(buf_, sizeof(buf_), "%s", s); }
+    const char *c_str() const { return buf_; }
+  private:
+    char buf_[64];
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) {}
+    size_t write(uint8_t c) { return 1; }
+    using Print::write;
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif  // Arduino_h
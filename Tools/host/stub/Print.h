@@ -0,0 +1,68 @@
+/*
+ * ======================================================================================================================
+ *  Print.h - Host stand-in for the Arduino Print class, numbers are formatted with snprintf()
+ * ======================================================================================================================
+ */
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+class __FlashStringHelper;
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t n) {
+      size_t r = 0;
+      while (n--) {
+        r += write(*buf++);
+      }
+      return r;
+    }
+    size_t write(const char *s) {
+      return write((const uint8_t *) s, strlen(s));
+    }
+    size_t write(const char *buf, size_t n) {
+      return write((const uint8_t *) buf, n);
+    }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+    int getWriteError() { return write_error; }
+    void clearWriteError() { write_error = 0; }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const __FlashStringHelper *s) { return write((const char *) s); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(int n, int base = 10) { return print((long) n, base); }
+    size_t print(unsigned int n, int base = 10) { return print((unsigned long) n, base); }
+    size_t print(long n, int base = 10) { return number(base == 16 ? "%lX" : "%ld", n); }
+    size_t print(unsigned long n, int base = 10) { return number(base == 16 ? "%lX" : "%lu", n); }
+    size_t print(double n, int digits = 2) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.*f", digits, n);
+      return write(buf);
+    }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T v) { return print(v) + println(); }
+    template <typename T> size_t println(T v, int base) { return print(v, base) + println(); }
+
+  protected:
+    void setWriteError(int err = 1) { write_error = err; }
+
+  private:
+    int write_error = 0;
+
+    template <typename T> size_t number(const char *fmt, T n) {
+      char buf[24];
+      snprintf(buf, sizeof(buf), fmt, n);
+      return write(buf);
+    }
+};
+
+#endif  // Print_h
@@ -0,0 +1,57 @@
+/*
+ * ======================================================================================================================
+ *  RTClib.h - Host stand-in for the Adafruit RTClib DateTime and DS3231, the clock is the virtual host_us
+ * ======================================================================================================================
+ */
+#ifndef RTClib_h
+#define RTClib_h
+
+#include <Arduino.h>
+
+class DateTime {
+  public:
+    DateTime(uint32_t t = 0) : t_(t) { civil(); }
+    DateTime(uint16_t y, uint8_t m, uint8_t d, uint8_t hh = 0, uint8_t mm = 0, uint8_t ss = 0) {
+      // Days from civil, proleptic Gregorian
+      int yy = y - (m <= 2);
+      int era = yy / 400;
+      unsigned yoe = yy - era * 400;
+      unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+      unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+      t_ = (uint32_t) (era * 146097 + (int) doe - 719468) * 86400 + hh * 3600 + mm * 60 + ss;
+      civil();
+    }
+    uint16_t year() const { return y_; }
+    uint8_t month() const { return m_; }
+    uint8_t day() const { return d_; }
+    uint8_t hour() const { return (t_ / 3600) % 24; }
+    uint8_t minute() const { return (t_ / 60) % 60; }
+    uint8_t second() const { return t_ % 60; }
+    uint32_t unixtime() const { return t_; }
+
+  private:
+    void civil() {
+      int z = t_ / 86400 + 719468;
+      int era = z / 146097;
+      unsigned doe = z - era * 146097;
+      unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+      unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+      unsigned mp = (5 * doy + 2) / 153;
+      d_ = doy - (153 * mp + 2) / 5 + 1;
+      m_ = mp < 10 ? mp + 3 : mp - 9;
+      y_ = yoe + era * 400 + (m_ <= 2);
+    }
+    uint32_t t_;
+    uint16_t y_;
+    uint8_t m_, d_;
+};
+
+class RTC_DS3231 {
+  public:
+    bool begin() { return true; }
+    DateTime now() { return DateTime((uint32_t) (host_us / 1000000)); }
+    void adjust(const DateTime &dt) { host_us = (uint64_t) dt.unixtime() * 1000000; }
+    bool lostPower() { return false; }
+};
+
+#endif  // RTClib_h
@@ -0,0 +1,31 @@
+/*
+ * ======================================================================================================================
+ *  SPI.h - Host stand-in for the Arduino SPI library, the bus is connected to the card emulator in sdemu.cpp
+ * ======================================================================================================================
+ */
+#ifndef SPI_h
+#define SPI_h
+
+#include <Arduino.h>
+
+class SPISettings {
+  public:
+    SPISettings(uint32_t clock = 4000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0) :
+      clock(clock) {}
+    uint32_t clock;
+};
+
+class SPIClass {
+  public:
+    void begin() {}
+    void end() {}
+    void beginTransaction(SPISettings settings);
+    void endTransaction() {}
+    uint8_t transfer(uint8_t data);
+    void transfer(void *buf, size_t count);
+    void transfer(const void *txbuf, void *rxbuf, size_t count, bool block = true);
+};
+
+extern SPIClass SPI;
+
+#endif  // SPI_h
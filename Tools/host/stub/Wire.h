@@ -0,0 +1,20 @@
+/*
+ * ======================================================================================================================
+ *  Wire.h - Host stand-in for the Arduino I2C library, there are no devices on the bus
+ * ======================================================================================================================
+ */
+#ifndef Wire_h
+#define Wire_h
+
+#include <Arduino.h>
+
+class TwoWire {
+  public:
+    void begin() {}
+    void beginTransmission(uint8_t address) {}
+    uint8_t endTransmission() { return 2; }   // Address NACK
+};
+
+extern TwoWire Wire;
+
+#endif  // Wire_h
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+mqtt_broker.py - A broker stand-in to try the SSG-Eth-ULP MQTT publisher against on a Linux host
+
+Takes the part of MQTT 3.1.1 the station uses, see SSG-Eth-ULP/MQTT.h: CONNECT with or without a clean session,
+QoS 0 and 1 PUBLISH, PINGREQ and DISCONNECT. Each publish is printed as its topic and payload. Sessions of clients
+that connect with clean session off are kept while this runs, so the station's CONNACK says session present when it
+wakes and connects again. Anything else, SUBSCRIBE or QoS 2, closes the connection.
+
+  python3 mqtt_broker.py                          # port 1883
+  python3 mqtt_broker.py --ack-delay 200          # PUBACK 200ms after the PUBLISH, like a slow link
+  python3 mqtt_broker.py --drop-every 5           # no PUBACK for every 5th publish, the station sends it again
+
+This is not a broker, nothing is passed on to subscribers.
+"""
+import argparse
+import socket
+import struct
+import sys
+import threading
+
+CONNECT, CONNACK, PUBLISH, PUBACK, PINGREQ, PINGRESP, DISCONNECT = 1, 2, 3, 4, 12, 13, 14
+
+sessions = set()                              # Client ids with a kept session
+lock = threading.Lock()
+
+
+def recv_exact(conn, n):
+    data = b""
+    while len(data) < n:
+        chunk = conn.recv(n - len(data))
+        if not chunk:
+            raise EOFError
+        data += chunk
+    return data
+
+
+def read_packet(conn):
+    """Returns the first byte of the fixed header and the rest of the packet"""
+    first = recv_exact(conn, 1)[0]
+    length, shift = 0, 0
+    while True:
+        b = recv_exact(conn, 1)[0]
+        length |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            break
+        if shift > 21:
+            raise ValueError("bad remaining length")
+    return first, recv_exact(conn, length)
+
+
+def string(body, at):
+    n = struct.unpack_from(">H", body, at)[0]
+    return body[at + 2:at + 2 + n].decode("utf-8", "replace"), at + 2 + n
+
+
+def client(conn, peer, args):
+    out = threading.Lock()                    # PUBACKs may be sent by timers
+
+    def send(data):
+        with out:
+            try:
+                conn.sendall(data)
+            except OSError:
+                pass
+
+    cid = None
+    count = 0
+    try:
+        first, body = read_packet(conn)
+        if first >> 4 != CONNECT:
+            raise ValueError("not CONNECT first")
+        name, at = string(body, 0)
+        level, flags = body[at], body[at + 1]
+        keepalive = struct.unpack_from(">H", body, at + 2)[0]
+        cid, at = string(body, at + 4)
+        user = password = None
+        if flags & 0x04:                      # Will topic and message, skipped
+            _, at = string(body, at)
+            _, at = string(body, at)
+        if flags & 0x80:
+            user, at = string(body, at)
+        if flags & 0x40:
+            password, at = string(body, at)
+        if name != "MQTT" or level != 4:
+            send(bytes([CONNACK << 4, 2, 0, 1]))  # Unacceptable protocol version
+            raise ValueError("protocol %s %d" % (name, level))
+
+        clean = bool(flags & 0x02)
+        with lock:
+            present = (not clean) and cid in sessions
+            if clean:
+                sessions.discard(cid)
+            else:
+                sessions.add(cid)
+        send(bytes([CONNACK << 4, 2, 1 if present else 0, 0]))
+        print("%s CONNECT %s clean=%d keepalive=%d user=%s password=%s session=%d" %
+              (peer[0], cid, clean, keepalive, user, "*" if password else None, present), flush=True)
+
+        while True:
+            first, body = read_packet(conn)
+            kind = first >> 4
+            if kind == PUBLISH:
+                qos = (first >> 1) & 3
+                topic, at = string(body, 0)
+                if qos == 1:
+                    pid = struct.unpack_from(">H", body, at)[0]
+                    at += 2
+                elif qos:
+                    raise ValueError("QoS %d" % qos)
+                count += 1
+                print("%s %s %s" % (cid, topic, body[at:].decode("utf-8", "replace")), flush=True)
+                if qos == 1 and not (args.drop_every and count % args.drop_every == 0):
+                    ack = bytes([PUBACK << 4, 2]) + struct.pack(">H", pid)
+                    if args.ack_delay:
+                        threading.Timer(args.ack_delay / 1000.0, send, (ack,)).start()
+                    else:
+                        send(ack)
+            elif kind == PINGREQ:
+                send(bytes([PINGRESP << 4, 0]))
+            elif kind == DISCONNECT:
+                break
+            else:
+                raise ValueError("packet type %d" % kind)
+    except EOFError:
+        pass
+    except (ValueError, IndexError, struct.error, OSError) as e:
+        sys.stderr.write("%s %s: %s\n" % (peer[0], cid, e))
+    finally:
+        print("%s %s closed after %d publishes" % (peer[0], cid, count), flush=True)
+        conn.close()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--bind", default="0.0.0.0")
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--ack-delay", type=int, default=0, help="ms before each PUBACK")
+    ap.add_argument("--drop-every", type=int, default=0, help="no PUBACK for every Nth publish")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((args.bind, args.port))
+    sock.listen(8)
+    while True:
+        conn, peer = sock.accept()
+        threading.Thread(target=client, args=(conn, peer, args), daemon=True).start()
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
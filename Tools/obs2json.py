@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""
+obs2json.py - Convert SSG-Eth-ULP binary logs to JSON lines
+
+Daily logs (/OBS/YYYY/MM/YYYYMMDD.obs) and the N2S file (N2SOBS.DAT) hold binary records, see
+"Observation Records" in SSG-Eth-ULP/OBS.h. This prints each record as the same JSON line the station's
+OBS_Export() writes, text records as they are.
+
+  python3 obs2json.py 20240131.obs [more files] > 20240131.log
+"""
+import struct
+import sys
+import time
+import zlib
+
+SD_REC_SYNC = 0xA5
+SD_SCHEMA_TEXT = 0
+OBS_SCHEMA = 1
+OBS_SCHEMA_DELTA = 2
+OBS_REC_DATA = 16
+
+F_OBS, I_OBS = 0, 1
+
+# id, type, bytes, scale - in step with obs_fields in OBS.h
+OBS_FIELDS = [
+    ("sg",   F_OBS, 2, 1),
+    ("dt1",  F_OBS, 2, 10),
+    ("bp1",  F_OBS, 2, 10),
+    ("bt1",  F_OBS, 2, 10),
+    ("bh1",  F_OBS, 2, 10),
+    ("bp2",  F_OBS, 2, 10),
+    ("bt2",  F_OBS, 2, 10),
+    ("bh2",  F_OBS, 2, 10),
+    ("mt1",  F_OBS, 2, 10),
+    ("mt2",  F_OBS, 2, 10),
+    ("st1",  F_OBS, 2, 10),
+    ("sh1",  F_OBS, 2, 10),
+    ("st2",  F_OBS, 2, 10),
+    ("sh2",  F_OBS, 2, 10),
+    ("pwk",  I_OBS, 4, 1),
+    ("ptk",  I_OBS, 4, 1),
+    ("plg",  I_OBS, 4, 1),
+    ("psn",  I_OBS, 4, 1),
+    ("pns",  I_OBS, 4, 1),
+    ("pdh",  I_OBS, 4, 1),
+    ("pqt",  I_OBS, 4, 1),
+    ("psl",  I_OBS, 4, 1),
+    ("pmas", F_OBS, 4, 10),
+    ("sq",   I_OBS, 4, 1),
+    ("n2sn", I_OBS, 2, 1),
+    ("n2sb", I_OBS, 2, 1),
+    ("n2sr", I_OBS, 2, 1),
+]
+
+
+class Observation:
+    """Values of a full record"""
+
+    def __init__(self, fields, ts, hth, bv, values):
+        self.fields = fields
+        self.ts = ts
+        self.hth = hth
+        self.bv = bv
+        self.values = values          # field index -> integer
+
+
+def wrap(v, bits):
+    """Two's complement wrap, as the station's fixed size integers do"""
+    v &= (1 << bits) - 1
+    return v - (1 << bits) if v >> (bits - 1) else v
+
+
+def varint(data, pos):
+    v = shift = 0
+    while True:
+        if pos >= len(data) or shift > 28:
+            raise ValueError("varint runs past record")
+        b = data[pos]
+        pos += 1
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return v, pos
+
+
+def unzigzag(u):
+    return (u >> 1) ^ -(u & 1)
+
+
+def full_record(rec):
+    fields, ts, hth, bv = struct.unpack_from("<IIIh", rec, 2)
+    values = {}
+    pos = OBS_REC_DATA
+    for f, (_, _, size, _) in enumerate(OBS_FIELDS):
+        if fields & (1 << f):
+            values[f] = struct.unpack_from("<h" if size == 2 else "<i", rec, pos)[0]
+            pos += size
+    if pos > len(rec):
+        raise ValueError("record too short for its fields")
+    return Observation(fields, ts, hth, bv, values)
+
+
+def delta_record(rec, prev, interval):
+    pos = 2
+    u, pos = varint(rec, pos)
+    ts = (prev.ts + interval + unzigzag(u)) & 0xFFFFFFFF
+    interval = (ts - prev.ts) & 0xFFFFFFFF
+    u, pos = varint(rec, pos)
+    hth = prev.hth ^ u
+    u, pos = varint(rec, pos)
+    bv = wrap(prev.bv + unzigzag(u), 16)
+    values = {}
+    for f, value in prev.values.items():
+        u, pos = varint(rec, pos)
+        values[f] = wrap(value + unzigzag(u), OBS_FIELDS[f][2] * 8)
+    return Observation(prev.fields, ts, hth, bv, values), interval
+
+
+def c_div(a, b):
+    """C integer division and remainder, truncating toward zero"""
+    q = abs(a) // abs(b) * (1 if (a < 0) == (b < 0) else -1)
+    return q, a - q * b
+
+
+def f32(x):
+    """Round to single precision, the station renders floats"""
+    return struct.unpack("<f", struct.pack("<f", x))[0]
+
+
+def render(o):
+    t = time.gmtime(o.ts)
+    q, r = c_div(o.bv, 100)
+    s = '{"at":"%d-%02d-%02dT%02d:%02d:%02d"' % (t.tm_year, t.tm_mon, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec)
+    s += ',"bv":%d.%02d,"hth":%d' % (q, r, o.hth)
+    for f in sorted(o.values):
+        fid, ftype, _, scale = OBS_FIELDS[f]
+        if ftype == F_OBS:
+            s += ',"%s":%.1f' % (fid, f32(o.values[f] / scale))
+        else:
+            s += ',"%s":%d' % (fid, o.values[f])
+    return s + "}"
+
+
+def frames(data):
+    """Yield (offset, record, bytes skipped before it) for each good [sync][record][crc32] frame, as SD_ReadRecord()"""
+    pos = 0
+    skipped = 0
+    while pos < len(data):
+        if data[pos] == SD_REC_SYNC and pos + 1 < len(data):
+            n = data[pos + 1]
+            end = pos + 1 + n
+            if n >= 2 and end + 4 <= len(data):
+                rec = data[pos + 1:end]
+                if zlib.crc32(rec) == struct.unpack_from("<I", data, end)[0]:
+                    yield pos, rec, skipped
+                    skipped = 0
+                    pos = end + 4
+                    continue
+        skipped += 1
+        pos += 1
+    if skipped:
+        yield pos, None, skipped
+
+
+def convert(path, out):
+    data = open(path, "rb").read()
+    prev = None
+    interval = 0
+    ok = True
+    for pos, rec, skipped in frames(data):
+        if skipped:
+            sys.stderr.write("%s: skipped %d bytes of torn or corrupt frames before %d\n" % (path, skipped, pos))
+            prev = None  # Wait for a keyframe
+            ok = False
+        if rec is None:
+            break
+        schema = rec[1]
+        try:
+            if schema == SD_SCHEMA_TEXT:
+                out.write(rec[2:].decode("latin-1") + "\n")
+                continue
+            if schema == OBS_SCHEMA:
+                prev = full_record(rec)
+                interval = 0
+            elif schema == OBS_SCHEMA_DELTA and prev is not None:
+                prev, interval = delta_record(rec, prev, interval)
+            else:
+                sys.stderr.write("%s: skipping record at %d, schema %d\n" % (path, pos, schema))
+                continue
+        except (ValueError, struct.error) as e:
+            sys.stderr.write("%s: bad record at %d, %s\n" % (path, pos, e))
+            continue
+        out.write(render(prev) + "\n")
+    return ok
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.stderr.write(__doc__)
+        sys.exit(2)
+    ok = True
+    for p in sys.argv[1:]:
+        ok = convert(p, sys.stdout) and ok
+    sys.exit(0 if ok else 1)
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+udp_collector.py - Receive SSG-Eth-ULP observation datagrams and pass them on to Chords
+
+Stations with udp_collector set in CONFIG.TXT send each observation as one UDP datagram, see SSG-Eth-ULP/UDP.h.
+This answers each with an ACK once Chords has taken the observation, as the same GET the station makes over HTTP.
+A repeat of an instrument_id and sq already passed on is ACKed again and not sent to Chords.
+
+  python3 udp_collector.py --chords http://some.domain.com
+  python3 udp_collector.py --dry-run          # print the URLs, ACK everything
+
+A station that gets no ACK falls back to HTTP, so stopping this only costs the stations energy.
+"""
+import argparse
+import collections
+import os
+import socket
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from obs2json import OBS_FIELDS, OBS_SCHEMA, OBS_REC_DATA, F_OBS, full_record, c_div, f32  # noqa: E402
+
+UDP_VERSION = 1
+SQ = [f[0] for f in OBS_FIELDS].index("sq")
+SEEN = 4096                                   # sq remembered per station
+
+
+def url(o, urlpath, key, instrument_id):
+    """The Chords URL the station renders for this observation, see OBS_Render()"""
+    t = time.gmtime(o.ts)
+    q, r = c_div(o.bv, 100)
+    s = "%s?key=%s&instrument_id=%d" % (urlpath, key, instrument_id)
+    s += "&at=%d-%02d-%02dT%02d%%3A%02d%%3A%02d" % (t.tm_year, t.tm_mon, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec)
+    s += "&bv=%d.%02d&hth=%d" % (q, r, o.hth)
+    for f in sorted(o.values):
+        fid, ftype, _, scale = OBS_FIELDS[f]
+        if ftype == F_OBS:
+            s += "&%s=%.1f" % (fid, f32(o.values[f] / scale))
+        else:
+            s += "&%s=%d" % (fid, o.values[f])
+    return s
+
+
+def parse(data):
+    """Returns instrument_id, apikey, record of a datagram, raises ValueError if it is not one"""
+    if len(data) < 8 or data[0:2] != b"SG" or data[2] != UDP_VERSION:
+        raise ValueError("not a version %d datagram" % UDP_VERSION)
+    instrument_id = struct.unpack_from("<I", data, 3)[0]
+    n = data[7]
+    key = data[8:8 + n].decode("latin-1")
+    rec = data[8 + n:]
+    if len(rec) < OBS_REC_DATA or rec[0] != len(rec) or rec[1] != OBS_SCHEMA:
+        raise ValueError("bad record")
+    return instrument_id, key, rec
+
+
+def forward(chords, path):
+    """GET the observation from Chords, returns the HTTP status or 0 if it could not be reached"""
+    try:
+        with urllib.request.urlopen(chords + path, timeout=10) as r:
+            return r.status
+    except urllib.error.HTTPError as e:
+        return e.code
+    except (urllib.error.URLError, OSError):
+        return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--bind", default="0.0.0.0")
+    ap.add_argument("--port", type=int, default=47600)
+    ap.add_argument("--chords", help="Chords server, http://host[:port]")
+    ap.add_argument("--urlpath", default="/measurements/url_create")
+    ap.add_argument("--dry-run", action="store_true", help="print the URLs instead of sending them")
+    args = ap.parse_args()
+    if not args.chords and not args.dry_run:
+        ap.error("--chords or --dry-run is needed")
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    seen = collections.defaultdict(lambda: collections.deque(maxlen=SEEN))
+    stats = collections.Counter()
+
+    while True:
+        data, peer = sock.recvfrom(2048)
+        stats["datagrams"] += 1
+        try:
+            instrument_id, key, rec = parse(data)
+            o = full_record(rec)
+        except (ValueError, struct.error) as e:
+            stats["bad"] += 1
+            sys.stderr.write("%s: %s\n" % (peer[0], e))
+            continue
+        if SQ not in o.values:
+            stats["bad"] += 1
+            sys.stderr.write("%s: no sq\n" % peer[0])
+            continue
+        sq = o.values[SQ] & 0xFFFFFFFF
+
+        if sq in seen[instrument_id]:
+            stats["repeats"] += 1
+            status = 200
+        else:
+            path = url(o, args.urlpath, key, instrument_id)
+            status = 200 if args.dry_run else forward(args.chords, path)
+            print("%s %d sq=%d %d %s" % (peer[0], instrument_id, sq, status, path), flush=True)
+            # Anything else is not ACKed, the station tries again over HTTP and hears about a 500 itself
+            if status == 200:
+                seen[instrument_id].append(sq)
+                stats["forwarded"] += 1
+            else:
+                stats["failed"] += 1
+
+        if status == 200:
+            sock.sendto(b"SA" + bytes([UDP_VERSION]) + struct.pack("<II", instrument_id, sq), peer)
+
+        if stats["datagrams"] % 100 == 0:
+            sys.stderr.write("%s\n" % dict(stats))
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
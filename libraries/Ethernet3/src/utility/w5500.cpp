@@ -23,15 +23,28 @@ W5500Class w5500;
 // SPI details
 SPISettings wiznet_SPI_settings(8000000, MSBFIRST, SPI_MODE0);
 uint8_t SPI_CS;
+uint32_t SPI_CS_micros;
+uint32_t SPI_CS_busy;
+
+void W5500Class::setSPIClock(uint32_t clock)
+{
+    wiznet_SPI_settings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+}
 
 void W5500Class::init(uint8_t socketNumbers, uint8_t ss_pin)
 {
   SPI_CS = ss_pin;
 
-  delay(1000);
   initSS();
+  digitalWrite(SPI_CS, HIGH);  // Deselect, not a transaction so not counted in SPI_CS_busy
   SPI.begin();
 
+  // Wait for the chip to come out of reset, reads of VERSIONR return garbage until it does
+  unsigned long start = millis();
+  while ((readVERSIONR() != 0x04) && (millis() - start < 1000)) {
+    delay(1);
+  }
+
   if(socketNumbers == 1) {
     for (int i = 1; i < MAX_SOCK_NUM; i++) {
       uint8_t cntl_byte = (0x0C + (i<<5));
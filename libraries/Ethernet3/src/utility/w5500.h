@@ -21,6 +21,8 @@
 #include <SPI.h>
 
 extern uint8_t SPI_CS;
+extern uint32_t SPI_CS_micros;  // micros() when SPI_CS was taken low
+extern uint32_t SPI_CS_busy;    // total micros SPI_CS has been low
 
 typedef uint8_t SOCKET;
 /*
@@ -135,6 +137,10 @@ public:
   static uint8_t softReset(void);
   uint8_t readVersion(void);
 
+  // SPI clock for W5500 transactions, and the time the chip has held the bus
+  void setSPIClock(uint32_t clock);
+  uint32_t busMicros(void) { return SPI_CS_busy; }
+
   /**
    * @brief	This function is being used for copy the data form Receive buffer of the chip to application buffer.
    *
@@ -245,6 +251,7 @@ public:
   __GP_REGISTER_N(UIPR,   0x0028, 4); // Unreachable IP address in UDP mode
   __GP_REGISTER16(UPORT,  0x002C);    // Unreachable Port address in UDP mode
   __GP_REGISTER8 (PHYCFGR,     0x002E);    // PHY Configuration register, default value: 0b 1011 1xxx
+  __GP_REGISTER8 (VERSIONR,    0x0039);    // Chip version, always reads 0x04
 
 
 #undef __GP_REGISTER8
@@ -342,8 +349,8 @@ private:
 private:
   // could do inline optimizations
   static inline void initSS()  { pinMode(SPI_CS, OUTPUT); }
-  static inline void setSS()   {  digitalWrite(SPI_CS, LOW); }
-  static inline void resetSS() {  digitalWrite(SPI_CS, HIGH); }
+  static inline void setSS()   {  SPI_CS_micros = micros(); digitalWrite(SPI_CS, LOW); }
+  static inline void resetSS() {  digitalWrite(SPI_CS, HIGH); SPI_CS_busy += micros() - SPI_CS_micros; }
 };
 
 extern W5500Class w5500;
@@ -487,6 +487,34 @@ namespace SDLib {
   }
 
 
+  File SDClass::open(File &dir, const char *filename, uint8_t mode) {
+    SdFile file;
+
+    if (! dir._file || ! dir._file->isDir()) {
+      return File();
+    }
+    if (! file.open(dir._file, filename, mode)) {
+      return File();
+    }
+    if ((mode & (O_APPEND | O_WRITE)) == (O_APPEND | O_WRITE)) {
+      file.seekSet(file.fileSize());
+    }
+    return File(file, filename);
+  }
+
+
+  boolean SDClass::rename(File &file, File &dir, const char *filename) {
+    if (! file._file || ! dir._file) {
+      return false;
+    }
+    if (! file._file->rename(dir._file, filename)) {
+      return false;
+    }
+    strncpy(file._name, filename, 12);
+    file._name[12] = 0;
+    return true;
+  }
+
   /*
     File SDClass::open(char *filepath, uint8_t mode) {
     //
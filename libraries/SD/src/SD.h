@@ -32,6 +32,8 @@ namespace SDLib {
 
     public:
       File(SdFile f, const char *name);     // wraps an underlying SdFile
+
+      friend class SDClass;
       File(void);      // 'empty' constructor
       virtual size_t write(uint8_t);
       virtual size_t write(const uint8_t *buf, size_t size);
@@ -82,6 +84,13 @@ namespace SDLib {
         return open(filename.c_str(), mode);
       }
 
+      // Open a file in a directory that is already open, without walking the path from the root. Keeping a
+      // directory open lets a sketch open files in it at a cost that does not depend on the path.
+      File open(File &dir, const char *filename, uint8_t mode = FILE_READ);
+
+      // Move an open file to filename in dir, the data is not copied. The new name must not exist.
+      boolean rename(File &file, File &dir, const char *filename);
+
       // Methods to determine if the requested file path exists.
       boolean exists(const char *filepath);
       boolean exists(const String &filepath) {
@@ -106,6 +115,44 @@ namespace SDLib {
         return rmdir(filepath.c_str());
       }
 
+      // Block I/O counters, for measuring how much card traffic an operation costs.
+      uint32_t blockReads() {
+        return card.readCount();
+      }
+      uint32_t blockWrites() {
+        return card.writeCount();
+      }
+
+      // Volume block cache lookups, for sizing SD_CACHE_BLOCKS.
+      uint32_t cacheHits() {
+        return SdVolume::cacheHits();
+      }
+      uint32_t cacheMisses() {
+        return SdVolume::cacheMisses();
+      }
+
+      // Cluster allocations, time spent searching the FAT and FAT blocks read doing it.
+      uint32_t allocCount() {
+        return SdVolume::allocCount();
+      }
+      uint32_t allocMicros() {
+        return SdVolume::allocMicros();
+      }
+      uint32_t allocMaxMicros() {
+        return SdVolume::allocMaxMicros();
+      }
+      uint32_t allocReads() {
+        return SdVolume::allocReads();
+      }
+
+      // Time the card has held the shared SPI bus, and the SPI clock used after begin().
+      uint32_t busMicros() {
+        return card.busMicros();
+      }
+      boolean setClock(uint32_t clock) {
+        return card.setSpiClock(clock);
+      }
+
     private:
 
       // This is used to determine the mode used to open a file
@@ -20,6 +20,10 @@
 #define USE_SPI_LIB
 #include <Arduino.h>
 #include "Sd2Card.h"
+#if defined(USE_SPI_LIB) && defined(ADAFRUIT_FEATHER_M0)
+  // Adafruit SAMD core moves SPI buffers with DMA, used for 512 byte blocks
+  #define USE_SPI_DMA
+#endif
 //------------------------------------------------------------------------------
 #ifndef SOFTWARE_SPI
 #ifdef USE_SPI_LIB
@@ -180,6 +184,7 @@ void Sd2Card::chipSelectHigh(void) {
   if (chip_select_asserted) {
     chip_select_asserted = 0;
     SDCARD_SPI.endTransaction();
+    busMicros_ += micros() - busStart_;
   }
   #endif
 }
@@ -188,6 +193,7 @@ void Sd2Card::chipSelectLow(void) {
   #ifdef USE_SPI_LIB
   if (!chip_select_asserted) {
     chip_select_asserted = 1;
+    busStart_ = micros();
     SDCARD_SPI.beginTransaction(settings);
   }
   #endif
@@ -417,6 +423,7 @@ uint8_t Sd2Card::readData(uint32_t block,
       error(SD_CARD_ERROR_CMD17);
       goto fail;
     }
+    readCount_++;
     if (!waitStartBlock()) {
       goto fail;
     }
@@ -454,9 +461,14 @@ uint8_t Sd2Card::readData(uint32_t block,
     spiRec();
   }
   // transfer data
+  #ifdef USE_SPI_DMA
+  memset(dst, 0XFF, count);
+  SDCARD_SPI.transfer(dst, dst, count);
+  #else  // USE_SPI_DMA
   for (uint16_t i = 0; i < count; i++) {
     dst[i] = spiRec();
   }
+  #endif  // USE_SPI_DMA
   #endif  // OPTIMIZE_HARDWARE_SPI
 
   offset_ += count;
@@ -466,6 +478,50 @@ uint8_t Sd2Card::readData(uint32_t block,
   }
   return true;
 
+fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Read one data block in a multiple block read sequence
+
+   \param[out] dst Pointer to the location for the 512 byte block.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t Sd2Card::readData(uint8_t* dst) {
+  if (!waitStartBlock()) {
+    goto fail;
+  }
+  #ifdef OPTIMIZE_HARDWARE_SPI
+  // start first spi transfer
+  SPDR = 0XFF;
+  for (uint16_t i = 0; i < 511; i++) {
+    while (!(SPSR & (1 << SPIF)))
+      ;
+    dst[i] = SPDR;
+    SPDR = 0XFF;
+  }
+  // wait for last byte
+  while (!(SPSR & (1 << SPIF)))
+    ;
+  dst[511] = SPDR;
+  #elif defined(USE_SPI_DMA)
+  // clock out 0XFF from the buffer that receives the block
+  memset(dst, 0XFF, 512);
+  SDCARD_SPI.transfer(dst, dst, 512);
+  #else  // OPTIMIZE_HARDWARE_SPI
+  for (uint16_t i = 0; i < 512; i++) {
+    dst[i] = spiRec();
+  }
+  #endif  // OPTIMIZE_HARDWARE_SPI
+  // discard crc
+  spiRec();
+  spiRec();
+  readCount_++;
+  return true;
+
 fail:
   chipSelectHigh();
   return false;
@@ -496,6 +552,53 @@ void Sd2Card::readEnd(void) {
   }
 }
 //------------------------------------------------------------------------------
+/** Start a read multiple blocks sequence.
+
+   \param[in] blockNumber Address of first block in sequence.
+
+   \note This function is used with readData() and readStop()
+   for optimized multiple block reads.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t Sd2Card::readStart(uint32_t blockNumber) {
+  // use address if not SDHC card
+  if (type() != SD_CARD_TYPE_SDHC) {
+    blockNumber <<= 9;
+  }
+  if (cardCommand(CMD18, blockNumber)) {
+    error(SD_CARD_ERROR_CMD18);
+    chipSelectHigh();
+    return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+/** End a read multiple blocks sequence.
+
+  \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t Sd2Card::readStop(void) {
+  // first byte after CMD12 is a stuff byte, skip it before the response
+  spiSend(CMD12 | 0x40);
+  for (int8_t i = 0; i < 4; i++) {
+    spiSend(0);
+  }
+  spiSend(0XFF);
+  spiRec();
+  for (uint8_t i = 0; ((status_ = spiRec()) & 0X80) && i != 0XFF; i++)
+    ;
+  if (status_ || !waitNotBusy(SD_WRITE_TIMEOUT)) {
+    error(SD_CARD_ERROR_CMD12);
+    chipSelectHigh();
+    return false;
+  }
+  chipSelectHigh();
+  return true;
+}
+//------------------------------------------------------------------------------
 /** read CID or CSR register */
 uint8_t Sd2Card::readRegister(uint8_t cmd, void* buf) {
   uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
@@ -684,6 +787,9 @@ uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
   while (!(SPSR & (1 << SPIF)))
     ;
 
+  #elif defined(USE_SPI_DMA)
+  spiSend(token);
+  SDCARD_SPI.transfer(src, NULL, 512);
   #else  // OPTIMIZE_HARDWARE_SPI
   spiSend(token);
   for (uint16_t i = 0; i < 512; i++) {
@@ -699,6 +805,7 @@ uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
     chipSelectHigh();
     return false;
   }
+  writeCount_++;
   return true;
 }
 //------------------------------------------------------------------------------
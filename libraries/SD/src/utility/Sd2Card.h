@@ -160,6 +160,10 @@ uint8_t const SD_CARD_ERROR_WRITE_PROGRAMMING = 0X14;
 uint8_t const SD_CARD_ERROR_WRITE_TIMEOUT = 0X15;
 /** incorrect rate selected */
 uint8_t const SD_CARD_ERROR_SCK_RATE = 0X16;
+/** card returned an error response for CMD12 (stop multiple block read) */
+uint8_t const SD_CARD_ERROR_CMD12 = 0X17;
+/** card returned an error response for CMD18 (read multiple blocks) */
+uint8_t const SD_CARD_ERROR_CMD18 = 0X18;
 //------------------------------------------------------------------------------
 // card types
 /** Standard capacity V1 SD card */
@@ -176,7 +180,12 @@ uint8_t const SD_CARD_TYPE_SDHC = 3;
 class Sd2Card {
   public:
     /** Construct an instance of Sd2Card. */
-    Sd2Card(void) : errorCode_(0), inBlock_(0), partialBlockRead_(0), type_(0) {}
+    Sd2Card(void) : errorCode_(0), inBlock_(0), partialBlockRead_(0), type_(0), readCount_(0), writeCount_(0),
+      busStart_(0), busMicros_(0) {}
+    /** \return Microseconds the card has held the SPI bus since init. */
+    uint32_t busMicros(void) const {
+      return busMicros_;
+    }
     uint32_t cardSize(void);
     uint8_t erase(uint32_t firstBlock, uint32_t lastBlock);
     uint8_t eraseSingleBlockEnable(void);
@@ -212,8 +221,13 @@ class Sd2Card {
       return partialBlockRead_;
     }
     uint8_t readBlock(uint32_t block, uint8_t* dst);
+    /** \return Number of blocks read from the card since init. */
+    uint32_t readCount(void) const {
+      return readCount_;
+    }
     uint8_t readData(uint32_t block,
                      uint16_t offset, uint16_t count, uint8_t* dst);
+    uint8_t readData(uint8_t* dst);
     /**
        Read a cards CID register. The CID contains card identification
        information such as Manufacturer ID, Product name, Product serial
@@ -228,6 +242,8 @@ class Sd2Card {
       return readRegister(CMD9, csd);
     }
     void readEnd(void);
+    uint8_t readStart(uint32_t blockNumber);
+    uint8_t readStop(void);
     uint8_t setSckRate(uint8_t sckRateID);
     #ifdef USE_SPI_LIB
     uint8_t setSpiClock(uint32_t clock);
@@ -237,6 +253,10 @@ class Sd2Card {
       return type_;
     }
     uint8_t writeBlock(uint32_t blockNumber, const uint8_t* src, uint8_t blocking = 1);
+    /** \return Number of blocks written to the card since init. */
+    uint32_t writeCount(void) const {
+      return writeCount_;
+    }
     uint8_t writeData(const uint8_t* src);
     uint8_t writeStart(uint32_t blockNumber, uint32_t eraseCount);
     uint8_t writeStop(void);
@@ -250,6 +270,10 @@ class Sd2Card {
     uint8_t partialBlockRead_;
     uint8_t status_;
     uint8_t type_;
+    uint32_t readCount_;
+    uint32_t writeCount_;
+    uint32_t busStart_;
+    uint32_t busMicros_;
     // private functions
     uint8_t cardAcmd(uint8_t cmd, uint32_t arg) {
       cardCommand(CMD55, 0);
@@ -278,6 +278,7 @@ class SdFile : public Print {
     int8_t readDir(dir_t* dir);
     static uint8_t remove(SdFile* dirFile, const char* fileName);
     uint8_t remove(void);
+    uint8_t rename(SdFile* dirFile, const char* newName);
     /** Set the file's current position to zero. */
     void rewind(void) {
       curPosition_ = curCluster_ = 0;
@@ -475,6 +476,24 @@ union cache_t {
   fbs_t    fbs;
 };
 //------------------------------------------------------------------------------
+#ifndef SD_CACHE_BLOCKS
+/**
+   Number of 512 byte blocks in the SdVolume cache, at least two. Slot zero
+   holds FAT blocks, the rest are shared LRU by directory and data blocks.
+*/
+#define SD_CACHE_BLOCKS 3
+#endif  // SD_CACHE_BLOCKS
+//------------------------------------------------------------------------------
+#ifndef SD_FAT_MAP_BYTES
+/**
+   Size of the SdVolume free cluster map, zero for none. One bit per group of
+   FAT blocks is set when a search finds the group full, so later searches
+   skip it without reading the FAT. Groups are one FAT block when the map is
+   big enough, 512 bytes covers 4096 FAT blocks.
+*/
+#define SD_FAT_MAP_BYTES 512
+#endif  // SD_FAT_MAP_BYTES
+//------------------------------------------------------------------------------
 /**
    \class SdVolume
    \brief Access FAT16 and FAT32 volumes on SD and SDHC cards.
@@ -488,8 +507,32 @@ class SdVolume {
     */
     static uint8_t* cacheClear(void) {
       cacheFlush();
-      cacheBlockNumber_ = 0XFFFFFFFF;
-      return cacheBuffer_.data;
+      cacheBlockNumber_[cacheSlot_] = 0XFFFFFFFF;
+      return cacheBuffer_[cacheSlot_].data;
+    }
+    /** \return Number of cache lookups found in the cache. */
+    static uint32_t cacheHits(void) {
+      return cacheHits_;
+    }
+    /** \return Number of cache lookups that had to read the card. */
+    static uint32_t cacheMisses(void) {
+      return cacheMisses_;
+    }
+    /** \return Number of cluster allocations. */
+    static uint32_t allocCount(void) {
+      return allocCount_;
+    }
+    /** \return Total microseconds spent searching the FAT for clusters. */
+    static uint32_t allocMicros(void) {
+      return allocMicros_;
+    }
+    /** \return Longest FAT search in microseconds. */
+    static uint32_t allocMaxMicros(void) {
+      return allocMaxMicros_;
+    }
+    /** \return Number of FAT blocks read from the card by FAT searches. */
+    static uint32_t allocReads(void) {
+      return allocReads_;
     }
     /**
        Initialize a FAT volume.  Try partition one first then try super
@@ -576,11 +619,26 @@ class SdVolume {
     // value for action argument in cacheRawBlock to indicate cache dirty
     static uint8_t const CACHE_FOR_WRITE = 1;
 
-    static cache_t cacheBuffer_;        // 512 byte cache for device blocks
-    static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+    // cache slot reserved for FAT blocks
+    static uint8_t const CACHE_SLOT_FAT = 0;
+
+    static cache_t cacheBuffer_[SD_CACHE_BLOCKS];       // 512 byte cache slots for device blocks
+    static uint32_t cacheBlockNumber_[SD_CACHE_BLOCKS]; // Logical number of block in each slot
+    static uint8_t cacheDirty_[SD_CACHE_BLOCKS];        // cacheFlush() will write slot if true
+    static uint8_t cacheAge_[SD_CACHE_BLOCKS];          // LRU order, zero is most recent
+    static uint8_t cacheSlot_;          // slot of the last block cached
+    static uint32_t cacheHits_;         // lookups found in the cache
+    static uint32_t cacheMisses_;       // lookups read from the card
     static Sd2Card* sdCard_;            // Sd2Card object for cache
-    static uint8_t cacheDirty_;         // cacheFlush() will write block if true
     static uint32_t cacheMirrorBlock_;  // block number for mirror FAT
+    static uint32_t allocCount_;        // cluster allocations
+    static uint32_t allocMicros_;       // time spent searching the FAT
+    static uint32_t allocMaxMicros_;    // longest FAT search
+    static uint32_t allocReads_;        // FAT blocks read by searches
+#if SD_FAT_MAP_BYTES
+    static uint8_t fatMap_[SD_FAT_MAP_BYTES];  // bit set if cluster group has no free cluster
+    static uint8_t fatMapShift_;        // shift to convert cluster number to map bit
+#endif  // SD_FAT_MAP_BYTES
     //
     uint32_t allocSearchStart_;   // start cluster for alloc search
     uint8_t blocksPerCluster_;    // cluster size in blocks
@@ -604,12 +662,28 @@ class SdVolume {
     uint32_t blockNumber(uint32_t cluster, uint32_t position) const {
       return clusterStartBlock(cluster) + blockOfCluster(position);
     }
+    /** \return The last block cached. */
+    static cache_t* cacheBuffer(void) {
+      return &cacheBuffer_[cacheSlot_];
+    }
+    /** \return Logical number of the last block cached. */
+    static uint32_t cacheBlockNumber(void) {
+      return cacheBlockNumber_[cacheSlot_];
+    }
+    static uint8_t cacheFatBlock(uint32_t blockNumber, uint8_t action);
+    static uint8_t cacheFind(uint32_t blockNumber);
     static uint8_t cacheFlush(uint8_t blocking = 1);
+    static void cacheInvalidate(uint32_t blockNumber);
     static uint8_t cacheMirrorBlockFlush(uint8_t blocking);
+    static uint8_t cacheNewBlock(uint32_t blockNumber);
     static uint8_t cacheRawBlock(uint32_t blockNumber, uint8_t action);
+    static uint8_t cacheSelect(uint32_t blockNumber, uint8_t action, uint8_t slot);
     static void cacheSetDirty(void) {
-      cacheDirty_ |= CACHE_FOR_WRITE;
+      cacheDirty_[cacheSlot_] |= CACHE_FOR_WRITE;
     }
+    static void cacheUse(uint8_t slot);
+    static uint8_t cacheVictim(void);
+    static uint8_t cacheWriteBack(uint8_t slot, uint8_t blocking);
     static uint8_t cacheZeroBlock(uint32_t blockNumber);
     uint8_t chainSize(uint32_t beginCluster, uint32_t* size) const;
     uint8_t fatGet(uint32_t cluster, uint32_t* value) const;
@@ -617,6 +691,20 @@ class SdVolume {
     uint8_t fatPutEOC(uint32_t cluster) {
       return fatPut(cluster, 0x0FFFFFFF);
     }
+#if SD_FAT_MAP_BYTES
+    static uint8_t fatMapFull(uint32_t cluster) {
+      uint32_t bit = cluster >> fatMapShift_;
+      return fatMap_[bit >> 3] & (1 << (bit & 7));
+    }
+    static void fatMapSet(uint32_t cluster, uint8_t full) {
+      uint32_t bit = cluster >> fatMapShift_;
+      if (full) {
+        fatMap_[bit >> 3] |= 1 << (bit & 7);
+      } else {
+        fatMap_[bit >> 3] &= ~(1 << (bit & 7));
+      }
+    }
+#endif  // SD_FAT_MAP_BYTES
     uint8_t freeChain(uint32_t cluster);
     uint8_t isEOC(uint32_t cluster) const {
       return  cluster >= (fatType_ == 16 ? FAT16EOC_MIN : FAT32EOC_MIN);
@@ -628,6 +716,8 @@ class SdVolume {
                      uint16_t count, uint8_t* dst) {
       return sdCard_->readData(block, offset, count, dst);
     }
+    uint8_t readBlocks(uint32_t block, uint8_t count, uint8_t* dst);
+    uint8_t writeBlocks(uint32_t block, uint8_t count, const uint8_t* src);
     uint8_t writeBlock(uint32_t block, const uint8_t* dst, uint8_t blocking = 1) {
       return sdCard_->writeBlock(block, dst, blocking);
     }
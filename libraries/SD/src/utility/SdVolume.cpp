@@ -20,13 +20,28 @@
 #include "SdFat.h"
 //------------------------------------------------------------------------------
 // raw block cache
-// init cacheBlockNumber_to invalid SD block number
-uint32_t SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
-cache_t  SdVolume::cacheBuffer_;     // 512 byte cache for Sd2Card
+// slots are set to invalid SD block numbers by init()
+cache_t  SdVolume::cacheBuffer_[SD_CACHE_BLOCKS];       // 512 byte slots for Sd2Card
+uint32_t SdVolume::cacheBlockNumber_[SD_CACHE_BLOCKS];
+uint8_t  SdVolume::cacheDirty_[SD_CACHE_BLOCKS];        // cacheFlush() will write slot if true
+uint8_t  SdVolume::cacheAge_[SD_CACHE_BLOCKS];
+uint8_t  SdVolume::cacheSlot_ = 0;
+uint32_t SdVolume::cacheHits_ = 0;
+uint32_t SdVolume::cacheMisses_ = 0;
 Sd2Card* SdVolume::sdCard_;          // pointer to SD card object
-uint8_t  SdVolume::cacheDirty_ = 0;  // cacheFlush() will write block if true
 uint32_t SdVolume::cacheMirrorBlock_ = 0;  // mirror  block for second FAT
 //------------------------------------------------------------------------------
+// cluster allocation counters and free cluster map
+// map bits are cleared by init() and fatPut() of a free cluster
+uint32_t SdVolume::allocCount_ = 0;
+uint32_t SdVolume::allocMicros_ = 0;
+uint32_t SdVolume::allocMaxMicros_ = 0;
+uint32_t SdVolume::allocReads_ = 0;
+#if SD_FAT_MAP_BYTES
+uint8_t  SdVolume::fatMap_[SD_FAT_MAP_BYTES];
+uint8_t  SdVolume::fatMapShift_ = 7;
+#endif  // SD_FAT_MAP_BYTES
+//------------------------------------------------------------------------------
 // find a contiguous group of clusters
 uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   // start of group
@@ -55,6 +70,17 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   // last cluster of FAT
   uint32_t fatEnd = clusterCount_ + 1;
 
+  // time the search and count the FAT blocks it reads
+  uint32_t searchMicros = micros();
+  uint32_t searchMisses = cacheMisses_;
+#if SD_FAT_MAP_BYTES
+  // clusters in one map group
+  uint32_t groupMask = (1UL << fatMapShift_) - 1;
+
+  // true while the group being searched has been full from its first cluster
+  uint8_t groupFull = false;
+#endif  // SD_FAT_MAP_BYTES
+
   // search the FAT for free clusters
   for (uint32_t n = 0;; n++, endCluster++) {
     // can't find space checked all clusters
@@ -66,10 +92,31 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
     if (endCluster > fatEnd) {
       bgnCluster = endCluster = 2;
     }
+#if SD_FAT_MAP_BYTES
+    // skip groups with no free cluster
+    if (fatMapFull(endCluster)) {
+      uint32_t next = (endCluster | groupMask) + 1;
+      n += next - endCluster - 1;
+      endCluster = next - 1;
+      bgnCluster = next;
+      continue;
+    }
+    if ((endCluster & groupMask) == 0 || endCluster == 2) {
+      groupFull = true;
+    }
+#endif  // SD_FAT_MAP_BYTES
     uint32_t f;
     if (!fatGet(endCluster, &f)) {
       return false;
     }
+#if SD_FAT_MAP_BYTES
+    if (f == 0) {
+      groupFull = false;
+    } else if (groupFull &&
+               (((endCluster + 1) & groupMask) == 0 || endCluster == fatEnd)) {
+      fatMapSet(endCluster, true);
+    }
+#endif  // SD_FAT_MAP_BYTES
 
     if (f != 0) {
       // cluster in use try next cluster as bgnCluster
@@ -79,6 +126,14 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
       break;
     }
   }
+  searchMicros = micros() - searchMicros;
+  allocCount_++;
+  allocMicros_ += searchMicros;
+  if (searchMicros > allocMaxMicros_) {
+    allocMaxMicros_ = searchMicros;
+  }
+  allocReads_ += cacheMisses_ - searchMisses;
+
   // mark end of chain
   if (!fatPutEOC(endCluster)) {
     return false;
@@ -108,28 +163,90 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   return true;
 }
 //------------------------------------------------------------------------------
+// cache a FAT block, FAT blocks always use the FAT slot
+uint8_t SdVolume::cacheFatBlock(uint32_t blockNumber, uint8_t action) {
+  return cacheSelect(blockNumber, action, CACHE_SLOT_FAT);
+}
+//------------------------------------------------------------------------------
+// return slot holding blockNumber or SD_CACHE_BLOCKS if not cached
+uint8_t SdVolume::cacheFind(uint32_t blockNumber) {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+    if (cacheBlockNumber_[i] == blockNumber) {
+      return i;
+    }
+  }
+  return SD_CACHE_BLOCKS;
+}
+//------------------------------------------------------------------------------
+// write back all dirty slots
 uint8_t SdVolume::cacheFlush(uint8_t blocking) {
-  if (cacheDirty_) {
-    if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data, blocking)) {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+    if (cacheDirty_[i]) {
+      if (!cacheWriteBack(i, blocking)) {
+        return false;
+      }
+      // card is busy with this block
+      if (!blocking) {
+        return true;
+      }
+    }
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// drop a cached block that is being written directly to the card
+void SdVolume::cacheInvalidate(uint32_t blockNumber) {
+  uint8_t slot = cacheFind(blockNumber);
+  if (slot < SD_CACHE_BLOCKS) {
+    cacheBlockNumber_[slot] = 0XFFFFFFFF;
+    cacheDirty_[slot] = 0;
+  }
+}
+//------------------------------------------------------------------------------
+// read count contiguous blocks with one CMD18 sequence
+uint8_t SdVolume::readBlocks(uint32_t block, uint8_t count, uint8_t* dst) {
+  // cached copies may be newer than the card
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+    if (cacheBlockNumber_[i] >= block && cacheBlockNumber_[i] < (block + count)) {
+      if (!cacheWriteBack(i, 1)) {
+        return false;
+      }
+    }
+  }
+  if (!sdCard_->readStart(block)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++, dst += 512) {
+    if (!sdCard_->readData(dst)) {
       return false;
     }
-
-    if (!blocking) {
-      return true;
+  }
+  return sdCard_->readStop();
+}
+//------------------------------------------------------------------------------
+// write count contiguous blocks with one pre-erased CMD25 sequence
+uint8_t SdVolume::writeBlocks(uint32_t block, uint8_t count, const uint8_t* src) {
+  // invalidate cache slots holding blocks being written
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+    if (cacheBlockNumber_[i] >= block && cacheBlockNumber_[i] < (block + count)) {
+      cacheBlockNumber_[i] = 0XFFFFFFFF;
+      cacheDirty_[i] = 0;
     }
-
-    // mirror FAT tables
-    if (!cacheMirrorBlockFlush(blocking)) {
+  }
+  if (!sdCard_->writeStart(block, count)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++, src += 512) {
+    if (!sdCard_->writeData(src)) {
       return false;
     }
-    cacheDirty_ = 0;
   }
-  return true;
+  return sdCard_->writeStop();
 }
 //------------------------------------------------------------------------------
 uint8_t SdVolume::cacheMirrorBlockFlush(uint8_t blocking) {
   if (cacheMirrorBlock_) {
-    if (!sdCard_->writeBlock(cacheMirrorBlock_, cacheBuffer_.data, blocking)) {
+    if (!sdCard_->writeBlock(cacheMirrorBlock_, cacheBuffer_[CACHE_SLOT_FAT].data, blocking)) {
       return false;
     }
     cacheMirrorBlock_ = 0;
@@ -137,32 +254,100 @@ uint8_t SdVolume::cacheMirrorBlockFlush(uint8_t blocking) {
   return true;
 }
 //------------------------------------------------------------------------------
+// cache a block that will be completely rewritten, it is not read from the card
+uint8_t SdVolume::cacheNewBlock(uint32_t blockNumber) {
+  uint8_t slot = cacheFind(blockNumber);
+  if (slot == SD_CACHE_BLOCKS) {
+    slot = cacheVictim();
+    if (!cacheWriteBack(slot, 1)) {
+      return false;
+    }
+    cacheBlockNumber_[slot] = blockNumber;
+  }
+  cacheUse(slot);
+  cacheSetDirty();
+  return true;
+}
+//------------------------------------------------------------------------------
+// cache a directory or data block
 uint8_t SdVolume::cacheRawBlock(uint32_t blockNumber, uint8_t action) {
-  if (cacheBlockNumber_ != blockNumber) {
-    if (!cacheFlush()) {
+  uint8_t slot = cacheFind(blockNumber);
+  return cacheSelect(blockNumber, action, slot < SD_CACHE_BLOCKS ? slot : cacheVictim());
+}
+//------------------------------------------------------------------------------
+// make blockNumber the current block, reading it into slot if not cached
+uint8_t SdVolume::cacheSelect(uint32_t blockNumber, uint8_t action, uint8_t slot) {
+  if (cacheBlockNumber_[slot] == blockNumber) {
+    cacheHits_++;
+  } else {
+    cacheMisses_++;
+    if (!cacheWriteBack(slot, 1)) {
       return false;
     }
-    if (!sdCard_->readBlock(blockNumber, cacheBuffer_.data)) {
+    cacheBlockNumber_[slot] = 0XFFFFFFFF;
+    if (!sdCard_->readBlock(blockNumber, cacheBuffer_[slot].data)) {
       return false;
     }
-    cacheBlockNumber_ = blockNumber;
+    cacheBlockNumber_[slot] = blockNumber;
+  }
+  cacheUse(slot);
+  cacheDirty_[slot] |= action;
+  return true;
+}
+//------------------------------------------------------------------------------
+// make slot the current and most recently used slot
+void SdVolume::cacheUse(uint8_t slot) {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+    if (cacheAge_[i] < cacheAge_[slot]) {
+      cacheAge_[i]++;
+    }
+  }
+  cacheAge_[slot] = 0;
+  cacheSlot_ = slot;
+}
+//------------------------------------------------------------------------------
+// least recently used slot that is not the FAT slot
+uint8_t SdVolume::cacheVictim(void) {
+  uint8_t slot = CACHE_SLOT_FAT + 1;
+  for (uint8_t i = slot + 1; i < SD_CACHE_BLOCKS; i++) {
+    if (cacheAge_[i] > cacheAge_[slot]) {
+      slot = i;
+    }
+  }
+  return slot;
+}
+//------------------------------------------------------------------------------
+// write slot to the card if dirty, the FAT slot also updates the mirror FAT
+uint8_t SdVolume::cacheWriteBack(uint8_t slot, uint8_t blocking) {
+  if (cacheDirty_[slot]) {
+    if (!sdCard_->writeBlock(cacheBlockNumber_[slot], cacheBuffer_[slot].data, blocking)) {
+      return false;
+    }
+
+    if (!blocking) {
+      return true;
+    }
+
+    // mirror FAT tables
+    if (slot == CACHE_SLOT_FAT && !cacheMirrorBlockFlush(blocking)) {
+      return false;
+    }
+    cacheDirty_[slot] = 0;
   }
-  cacheDirty_ |= action;
   return true;
 }
 //------------------------------------------------------------------------------
 // cache a zero block for blockNumber
 uint8_t SdVolume::cacheZeroBlock(uint32_t blockNumber) {
-  if (!cacheFlush()) {
+  if (!cacheNewBlock(blockNumber)) {
     return false;
   }
 
   // loop take less flash than memset(cacheBuffer_.data, 0, 512);
+  uint8_t* data = cacheBuffer()->data;
   for (uint16_t i = 0; i < 512; i++) {
-    cacheBuffer_.data[i] = 0;
+    data[i] = 0;
   }
-  cacheBlockNumber_ = blockNumber;
-  cacheSetDirty();
   return true;
 }
 //------------------------------------------------------------------------------
@@ -186,15 +371,13 @@ uint8_t SdVolume::fatGet(uint32_t cluster, uint32_t* value) const {
   }
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
-  if (lba != cacheBlockNumber_) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) {
-      return false;
-    }
+  if (!cacheFatBlock(lba, CACHE_FOR_READ)) {
+    return false;
   }
   if (fatType_ == 16) {
-    *value = cacheBuffer_.fat16[cluster & 0XFF];
+    *value = cacheBuffer_[CACHE_SLOT_FAT].fat16[cluster & 0XFF];
   } else {
-    *value = cacheBuffer_.fat32[cluster & 0X7F] & FAT32MASK;
+    *value = cacheBuffer_[CACHE_SLOT_FAT].fat32[cluster & 0X7F] & FAT32MASK;
   }
   return true;
 }
@@ -215,18 +398,21 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
 
-  if (lba != cacheBlockNumber_) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) {
-      return false;
-    }
+  if (!cacheFatBlock(lba, CACHE_FOR_WRITE)) {
+    return false;
   }
   // store entry
   if (fatType_ == 16) {
-    cacheBuffer_.fat16[cluster & 0XFF] = value;
+    cacheBuffer_[CACHE_SLOT_FAT].fat16[cluster & 0XFF] = value;
   } else {
-    cacheBuffer_.fat32[cluster & 0X7F] = value;
+    cacheBuffer_[CACHE_SLOT_FAT].fat32[cluster & 0X7F] = value;
   }
-  cacheSetDirty();
+#if SD_FAT_MAP_BYTES
+  // group has a free cluster again
+  if (value == 0) {
+    fatMapSet(cluster, false);
+  }
+#endif  // SD_FAT_MAP_BYTES
 
   // mirror second FAT
   if (fatCount_ > 1) {
@@ -275,6 +461,14 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
 uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
   uint32_t volumeStartBlock = 0;
   sdCard_ = dev;
+
+  // empty the cache, blocks from another card or volume are not valid
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+    cacheBlockNumber_[i] = 0XFFFFFFFF;
+    cacheDirty_[i] = 0;
+    cacheAge_[i] = i;
+  }
+  cacheMirrorBlock_ = 0;
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
@@ -284,7 +478,7 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
     if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) {
       return false;
     }
-    part_t* p = &cacheBuffer_.mbr.part[part - 1];
+    part_t* p = &cacheBuffer()->mbr.part[part - 1];
     if ((p->boot & 0X7F) != 0  ||
         p->totalSectors < 100 ||
         p->firstSector == 0) {
@@ -296,7 +490,7 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
   if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) {
     return false;
   }
-  bpb_t* bpb = &cacheBuffer_.fbs.bpb;
+  bpb_t* bpb = &cacheBuffer()->fbs.bpb;
   if (bpb->bytesPerSector != 512 ||
       bpb->fatCount == 0 ||
       bpb->reservedSectorCount == 0 ||
@@ -347,5 +541,13 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
     rootDirStart_ = bpb->fat32RootCluster;
     fatType_ = 32;
   }
+#if SD_FAT_MAP_BYTES
+  // one FAT block per map bit, or the fewest blocks that fit the map
+  memset(fatMap_, 0, sizeof(fatMap_));
+  fatMapShift_ = fatType_ == 16 ? 8 : 7;
+  while (((clusterCount_ + 1) >> fatMapShift_) >= 8UL * SD_FAT_MAP_BYTES) {
+    fatMapShift_++;
+  }
+#endif  // SD_FAT_MAP_BYTES
   return true;
 }